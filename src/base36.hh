@@ -1,10 +1,16 @@
 #pragma once
 #include "util.hh"
+#include <array>
+#include <cstdint>
+#include <cstring>
 #include <limits>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <concepts>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 // Header file for ANY base (but 36 and 10 mainly)
 
@@ -62,15 +68,30 @@ struct Base {
 
 	/* ~~ Member Functions ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+	// Every char's digit value, (or B for chars not in the alphabet,
+	// which is where searching the alphabet for them used to end up).
+	static constexpr auto digitTable = [] {
+		std::array<uint16_t, 256> table {};
+		table.fill(B);
+		for (std::size_t i=0; i<B; i++) table[uint8_t(Alphabet[i])] = i;
+		return table;
+	} ();
+
+	// Same, but reading uppercase letters as their lowercase digits.
+	static constexpr auto foldedTable = [] {
+		std::array<uint16_t, 256> table {};
+		for (std::size_t c=0; c<256; c++) {
+			table[c] = digitTable['A' <= c && c <= 'Z' ? c + ('a'-'A') : c];
+		}
+		return table;
+	} ();
+
 	static auto isDigit(char c) -> bool {
-		return Util::contains(Alphabet, c);
+		return digitTable[uint8_t(c)] < B;
 	}
 
 	static auto digitValue(char c) -> std::size_t {
-		return std::distance(
-			ranges::begin(Alphabet),
-			ranges::find(Alphabet, c)
-		);
+		return digitTable[uint8_t(c)];
 	}
 
 	// Compiletime Size:
@@ -110,6 +131,23 @@ struct Base {
 		return result;
 	}
 
+	// The same digits, written straight into out, (giving one past them).
+	template <std::size_t N, std::integral T, std::integral U>
+	requires (N <= MaxDigitCount<T>())
+	static auto toChars(U x, char* out)
+	-> char* {
+		if constexpr (std::is_signed_v<T>) {
+			if (x < 0) x += capacity<N>();
+		}
+
+		for (std::size_t i=0; i<N; i++) {
+			out[N-1 - i] = Alphabet[x % B];
+			x /= B;
+		}
+
+		return out + N;
+	}
+
 	// Runtime Size:
 
 	template <std::integral T>
@@ -153,11 +191,70 @@ struct Base {
 		constexpr T operator*() { return value; }
 	};
 
+	// Tuples of fixed-width numbers packed end to end, (e.g. the 3+3+2
+	// digit points of a Brush stroke), handed to makeObj one at a time.
+	// Nothing comes back if any digit's bad or the last tuple's short.
 	template <typename... Nums, typename Res>
 	static std::optional<std::vector<Res>>
 	parseTuples(
 		std::string_view str,
 		Res (*makeObj)(Nums...)
+	) {
+		return decodeTuples<false>(str, '\0', makeObj);
+	}
+
+	// Same again, but passing over any "skip" chars wherever they are,
+	// (like the tick marks in strokes), and ignoring case.
+	template <typename... Nums, typename Res>
+	static std::optional<std::vector<Res>>
+	parseTuples(
+		std::string_view str,
+		char skip,
+		Res (*makeObj)(Nums...)
+	) {
+		return decodeTuples<true>(str, skip, makeObj);
+	}
+
+	// Same as the skipping version, but each tuple's numbers go straight
+	// to visit rather than into a vector, (so nothing's allocated), and
+	// skips can only go singly between digits, (like the ticks in strokes).
+	// Stops at the first char that's neither, giving how far that was,
+	// or nothing if what came before it doesn't parse, (though visit may
+	// have seen a few tuples by then). Branch free apart from each
+	// tuple's end, since skips every few chars otherwise trip up both
+	// the blocks and the branches parseTuples has.
+	template <typename... Nums, typename Visit>
+	static auto visitTuples(
+		std::string_view str,
+		char skip,
+		Visit&& visit
+	) -> std::optional<std::size_t> {
+		constexpr std::size_t stride = ( Nums::size + ... );
+		uint8_t digits[stride];
+		std::size_t i = 0, j = 0;
+		bool skipped = true, bad = false; // (As if one came before.)
+		for (; i<str.size(); i++) {
+			const char c = str[i];
+			const uint8_t digit = foldedTable[uint8_t(c)];
+			const bool isDigit = digit < B, isSkip = c == skip;
+			if (!isDigit & !isSkip) break;
+			bad |= isSkip & skipped;
+			skipped = isSkip;
+			digits[j] = digit;
+			j += isDigit;
+			if (j == stride) decodeTuple<Nums...>(digits, visit), j = 0;
+		}
+		if (bad || skipped || j != 0) return std::nullopt;
+		return i;
+	}
+
+	// The plain version, parsing each number on its own. (parseTuples
+	// has to give exactly what this does, see bench/base36Bench.cc.)
+	template <typename... Nums, typename Res>
+	static std::optional<std::vector<Res>>
+	parseTuplesGeneric(
+		std::string_view str,
+		Res (*makeObj)(Nums...)
 	) {
 		auto parseI = [&str]<std::size_t N, std::integral T>(
 			std::size_t& i, Number_t<N,T>
@@ -166,7 +263,7 @@ struct Base {
 			i += N; return result;
 		};
 
-		constexpr auto nums = std::tuple<Nums...> {};		
+		constexpr auto nums = std::tuple<Nums...> {};
 		constexpr auto stride = std::apply([](auto&&... num) {
 			return ( num.size + ... );
 		}, nums);
@@ -197,6 +294,123 @@ struct Base {
 
 		return result;
 	}
+
+private:
+	template <bool Lenient, typename... Nums, typename Res>
+	static auto decodeTuples(
+		std::string_view str,
+		char skip,
+		Res (*makeObj)(Nums...)
+	) -> std::optional<std::vector<Res>> {
+		constexpr std::size_t stride = ( Nums::size + ... );
+		if (!Lenient && str.size()%stride != 0) return std::nullopt;
+		constexpr auto& table = Lenient ? foldedTable : digitTable;
+
+		std::vector<Res> result {};
+		result.reserve(str.size()/stride);
+		auto emit = [&](const uint8_t* digits) {
+			result.push_back(decodeTuple<Nums...>(digits, makeObj));
+		};
+		auto skipped = [&](std::size_t i) {
+			if constexpr (Lenient) while (i < str.size() && str[i] == skip) i++;
+			return i;
+		};
+
+		uint8_t digits[16];
+		for (std::size_t i=skipped(0); i<str.size(); i=skipped(i)) {
+			// Whole tuples, as many as fit in 16 chars, 16 chars at a
+			// time, (when there's nothing in them to skip or fold).
+			if constexpr (VectorDigits && stride <= 16) {
+				constexpr std::size_t perBlock = 16/stride, used = perBlock*stride;
+				if (i+16 <= str.size() && vectorDigits(str.data() + i, used, digits)) {
+					for (std::size_t t=0; t<perBlock; t++) emit(digits + t*stride);
+					i += used;
+					continue;
+				}
+			}
+
+			// Otherwise one tuple, a char at a time.
+			for (std::size_t j=0; j<stride; j++, i++) {
+				i = skipped(i);
+				if (i == str.size()) return std::nullopt;
+				digits[j] = table[uint8_t(str[i])];
+				if (digits[j] >= B) return std::nullopt;
+			}
+			emit(digits);
+		}
+
+		return result;
+	}
+
+	// Already checked digits -> one number, (2's-complement if signed).
+	template <std::size_t N, std::integral T>
+	static auto decodeNumber(const uint8_t* digits) -> T {
+		T result {};
+		for (std::size_t i=0; i<N; i++) result = B * result + digits[i];
+
+		if constexpr (std::is_signed_v<T>) {
+			if (result >= T(rollover<N>())) result -= capacity<N>();
+		}
+
+		return result;
+	}
+
+	template <typename... Nums, typename MakeObj>
+	static auto decodeTuple(const uint8_t* digits, MakeObj&& makeObj)
+	-> decltype(auto) {
+		// Where each number starts within the tuple.
+		constexpr auto offsets = [] {
+			std::array<std::size_t, sizeof...(Nums)> sizes {Nums::size...}, result {};
+			for (std::size_t i=1; i<sizes.size(); i++) {
+				result[i] = result[i-1] + sizes[i-1];
+			}
+			return result;
+		} ();
+
+		return [&]<std::size_t... I>(std::index_sequence<I...>) {
+			return makeObj(Nums {
+				decodeNumber<Nums::size, typename Nums::type>(digits + offsets[I])
+			} ...);
+		} (std::index_sequence_for<Nums...> {});
+	}
+
+	/* ~~ Vectorized Digits ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+	// Alphabets starting "0-9a-z" can be decoded with a couple of
+	// subtractions, 16 chars at once, (SSE on native, simd128 on wasm).
+	static constexpr bool VectorDigits = [] {
+		constexpr std::string_view standard = "0123456789abcdefghijklmnopqrstuvwxyz";
+		if (B > standard.size()) return false;
+		for (std::size_t i=0; i<B; i++) {
+			if (Alphabet[i] != standard[i]) return false;
+		}
+		return true;
+	} ();
+
+	using Bytes = uint8_t __attribute__((vector_size(16)));
+
+	// Digit values of the 16 chars at str, (of which the first "used"
+	// have to be digits), or false if they aren't.
+	static auto vectorDigits(const char* str, std::size_t used, uint8_t* out)
+	-> bool {
+		constexpr Bytes lanes {0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15};
+		Bytes c;
+		std::memcpy(&c, str, 16);
+
+		const Bytes num = c - '0', alpha = c - 'a';
+		const Bytes isNum   = (Bytes)(num   < 10);
+		const Bytes isAlpha = (Bytes)(alpha < 26);
+		// Anything that's neither gets 0xFF, so fails the check below.
+		const Bytes value = (num & isNum) | ((alpha + 10) & isAlpha) | ~(isNum | isAlpha);
+		const Bytes bad = (Bytes)(value >= uint8_t(B)) & (Bytes)(lanes < uint8_t(used));
+
+		uint64_t halves[2];
+		std::memcpy(halves, &bad, 16);
+		if (halves[0] | halves[1]) return false;
+
+		std::memcpy(out, &value, 16);
+		return true;
+	}
 };
 
 using Base10 = Base<10,"0123456789">;
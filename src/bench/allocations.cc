@@ -0,0 +1,30 @@
+#include "bench.hh"
+#include <cstdlib>
+#include <new>
+
+// Counts every allocation, for the benchmarks that want to know how
+// often (and how much) they touch the heap. Every block remembers its
+// size just in front of it, so what's live can be kept track of too.
+
+std::atomic<std::size_t> allocations {0}, allocated {0};
+std::atomic<std::size_t> liveBytes {0}, peakBytes {0};
+
+void* operator new(std::size_t n) {
+	auto* p = static_cast<std::max_align_t*>(std::malloc(n + sizeof(std::max_align_t)));
+	if (!p) throw std::bad_alloc {};
+	*reinterpret_cast<std::size_t*>(p) = n;
+	allocations++;
+	allocated += n;
+	const std::size_t live = liveBytes += n;
+	for (std::size_t peak = peakBytes; peak < live && !peakBytes.compare_exchange_weak(peak, live); ) {}
+	return p + 1;
+}
+
+void operator delete(void* p) noexcept {
+	if (!p) return;
+	auto* block = static_cast<std::max_align_t*>(p) - 1;
+	liveBytes -= *reinterpret_cast<std::size_t*>(block);
+	std::free(block);
+}
+
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
@@ -0,0 +1,96 @@
+#include "../base36.hh"
+#include "bench.hh"
+#include <cstdio>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Decoding point tuples with parseTuples, against the plain generic
+// version it replaced. First a fuzz over random (and often broken)
+// strings, which must decode exactly the same, (with ticks and case
+// too, against filtering those out first), then the speed of both on
+// a long well-formed Brush stroke.
+
+using Brush3 = std::tuple<int, int, unsigned>;
+using Data2  = std::tuple<int, int>;
+using Raw2   = std::tuple<unsigned, unsigned>;
+
+auto brushPoint(Base36::Number_t<3,signed> x, Base36::Number_t<3,signed> y, Base36::Number_t<2,unsigned> p)
+-> Brush3 { return {*x, *y, *p}; }
+auto dataPoint(Base36::Number_t<3,signed> x, Base36::Number_t<3,signed> y)
+-> Data2 { return {*x, *y}; }
+auto rawPoint(Base36::Number_t<2,unsigned> x, Base36::Number_t<2,unsigned> y)
+-> Raw2 { return {*x, *y}; }
+
+// Mostly digits, sometimes something else, (uppercase, ticks, bytes
+// past ASCII, and the chars either side of each digit range).
+auto randomString(std::mt19937& rng, std::size_t length, bool valid) -> std::string {
+	constexpr std::string_view digits = "0123456789abcdefghijklmnopqrstuvwxyz";
+	constexpr std::string_view others = "/:`{@AZQ'' \x80\xff\0"sv;
+	std::uniform_int_distribution<std::size_t> digit {0, digits.size()-1}, other {0, others.size()-1};
+	std::bernoulli_distribution broken {valid ? 0.0 : 2.0/std::max(length, 2uz)};
+	std::string result (length, '0');
+	for (char& c : result) c = broken(rng) ? others[other(rng)] : digits[digit(rng)];
+	return result;
+}
+
+int main() {
+	bool same = true;
+
+	// The table against searching the alphabet, for every char.
+	constexpr std::string_view alphabet = "0123456789abcdefghijklmnopqrstuvwxyz";
+	for (int c=0; c<256; c++) {
+		const std::size_t i = std::min(alphabet.find(char(c)), alphabet.size());
+		same &= Base36::isDigit(c) == (i < alphabet.size());
+		same &= Base36::digitValue(c) == i;
+	}
+
+	std::mt19937 rng {15};
+	// Mostly whole tuples of all three sizes, (24 chars), some not.
+	std::uniform_int_distribution<std::size_t> tuples {0, 6}, extra {0, 23};
+	std::bernoulli_distribution ragged {0.2}, valid {0.5};
+	auto length = [&] { return 24*tuples(rng) + (ragged(rng) ? extra(rng) : 0); };
+	std::size_t cases = 0, failures = 0;
+	for (int i=0; i<200'000; i++, cases += 3) {
+		const auto str = randomString(rng, length(), valid(rng));
+		auto a = Base36::parseTuples(str, brushPoint), b = Base36::parseTuplesGeneric(str, brushPoint);
+		auto c = Base36::parseTuples(str, dataPoint ), d = Base36::parseTuplesGeneric(str, dataPoint );
+		auto e = Base36::parseTuples(str, rawPoint  ), f = Base36::parseTuplesGeneric(str, rawPoint  );
+		same &= a == b && c == d && e == f;
+		failures += !b + !d + !f;
+	}
+	// What stroke parsing used to hand to parseTuples.
+	auto withoutTicks = [](std::string_view str) {
+		std::string result {};
+		for (char c : str) if (c != '\'') result += 'A' <= c && c <= 'Z' ? c - 'A' + 'a' : c;
+		return result;
+	};
+	for (int i=0; i<200'000; i++, cases += 3) {
+		const auto str = randomString(rng, length(), valid(rng));
+		const auto plain = withoutTicks(str);
+		auto a = Base36::parseTuples(str, '\'', brushPoint), b = Base36::parseTuplesGeneric(plain, brushPoint);
+		auto c = Base36::parseTuples(str, '\'', dataPoint ), d = Base36::parseTuplesGeneric(plain, dataPoint );
+		auto e = Base36::parseTuples(str, '\'', rawPoint  ), f = Base36::parseTuplesGeneric(plain, rawPoint  );
+		same &= a == b && c == d && e == f;
+		failures += !b + !d + !f;
+	}
+
+	std::printf("%zu fuzz cases, (%zu rejected) %s\n",
+		cases, failures, same ? "identical" : "DIFFER");
+
+	// A 200k point stroke, as removeTicks would hand it over.
+	const auto stroke = randomString(rng, 8*200'000, true);
+	std::size_t points = 0;
+	const double generic = msPerCall(20, [&] {
+		points += Base36::parseTuplesGeneric(stroke, brushPoint)->size();
+	});
+	const double fast = msPerCall(20, [&] {
+		points += Base36::parseTuples(stroke, brushPoint)->size();
+	});
+	std::printf("%-8s %8.2f ms\n", "generic", generic);
+	std::printf("%-8s %8.2f ms %6.2fx\n", "tuples", fast, generic/fast);
+
+	same &= points == 2*20*200'000;
+	return !same;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+// What every benchmark times things with, and counts the heap with.
+
+// Average time of n calls of f.
+template <typename F>
+double msPerCall(std::size_t n, F&& f) {
+	auto t0 = std::chrono::steady_clock::now();
+	for (std::size_t i=0; i<n; i++) f();
+	auto t1 = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(t1-t0).count() / n;
+}
+
+template <typename F>
+double nsPerCall(std::size_t n, F&& f) { return 1e6 * msPerCall(n, f); }
+
+// Time of a single call of f.
+template <typename F>
+double msFor(F&& f) { return msPerCall(1, f); }
+
+// Kept up by the operator new in allocations.cc, (so only there in
+// benchmarks linked with it). Sizes are what was asked for.
+extern std::atomic<std::size_t> allocations, allocated;
+extern std::atomic<std::size_t> liveBytes, peakBytes;
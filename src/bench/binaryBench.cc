@@ -0,0 +1,98 @@
+#include "../parsers.hh"
+#include "bench.hh"
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Sizes and decode speeds of BinaryFormat against the text format, on
+// the sample sketch (or any given) and a big generated one drawn like a
+// pen would, (small smooth steps and pressure). Each has to come back
+// from bytes exactly as it went in, and broken copies of the bytes have
+// to be turned down without crashing.
+
+auto penElement(std::mt19937& rng) -> Element {
+	std::uniform_int_distribution<int> x {0, 799}, y {0, 599}, length {20, 200}, diameter {1, 12};
+	std::normal_distribution<double> turn {0, 0.3}, squeeze {0, 0.02};
+	std::uniform_real_distribution<double> angle {0, 6.283};
+	Brush brush {};
+	for (int i=0; i<8; i++) {
+		Atom::Stroke s {unsigned(diameter(rng)), {}};
+		double px = x(rng), py = y(rng), a = angle(rng), pressure = 0.5;
+		for (int j=length(rng); j>0; j--) {
+			s.points.push_back({int(px), int(py), pressure});
+			a += turn(rng);
+			px += 3*std::cos(a), py += 3*std::sin(a);
+			pressure = std::clamp(pressure + squeeze(rng), 0.0, 1.0);
+		}
+		brush.atoms.push_back(s);
+	}
+	if (rng() % 4 == 0) brush.modifiers.push_back(Mod::Affine {{1,0,40, 0,1,0, 0,0,1}});
+	return brush;
+}
+
+auto printed(const Sketch& sketch) -> std::string {
+	std::ostringstream os;
+	SketchFormat::print(os, sketch);
+	return os.str();
+}
+
+auto binary(const Sketch& sketch) -> std::string {
+	std::ostringstream os;
+	BinaryFormat::print(os, sketch);
+	return os.str();
+}
+
+int main(int argc, char** argv) {
+	std::vector<std::pair<std::string, std::string>> inputs {};
+	std::vector<const char*> paths {argv+1, argv+argc};
+	if (paths.empty()) paths.push_back("../tests/example file.hsc");
+	for (const char* path : paths) {
+		std::ifstream input {path};
+		if (!input) { std::printf("can't open %s\n", path); return 1; }
+		inputs.push_back({path, {std::istreambuf_iterator<char> {input}, {}}});
+	}
+	std::mt19937 rng {21};
+	std::vector<Element> elements {};
+	for (int i=0; i<5'000; i++) elements.push_back(penElement(rng));
+	inputs.push_back({"(generated)", printed(Sketch {elements})});
+
+	bool identical = true;
+	for (const auto& [name, text] : inputs) {
+		auto sketch = SketchFormat::parse(text);
+		if (!sketch) { std::printf("%s: parse error\n", name.c_str()); identical = false; continue; }
+		const std::string bytes = binary(*sketch);
+		auto decoded = BinaryFormat::parse(bytes);
+		identical &= decoded && printed(*decoded) == printed(*sketch) && binary(*decoded) == bytes;
+
+		const std::size_t runs = std::max(1uz, (8 << 20) / text.size());
+		const double parse  = msPerCall(runs, [&] { SketchFormat::parse(text); });
+		const double decode = msPerCall(runs, [&] { BinaryFormat::parse(bytes); });
+		const double encode = msPerCall(runs, [&] { binary(*sketch); });
+		std::printf("%s:\n", name.c_str());
+		std::printf("  %10zu bytes of text %10zu bytes of binary %6.1fx smaller\n",
+			text.size(), bytes.size(), double(text.size()) / bytes.size());
+		std::printf("  %10.3f ms parse %10.3f ms decode %6.1fx faster %8.3f ms encode\n",
+			parse, decode, parse/decode, encode);
+	}
+
+	// Broken bytes: cut short, or a byte changed.
+	const std::string bytes = binary(Sketch {{elements.begin(), elements.begin()+20}});
+	std::size_t rejected = 0;
+	for (int i=0; i<20'000; i++) {
+		std::string broken = bytes;
+		const std::size_t at = rng() % broken.size();
+		if (i % 2) broken.resize(at);
+		else broken[at] ^= char(1 << rng() % 8);
+		auto result = BinaryFormat::parse(broken);
+		rejected += !result;
+		if (result) binary(*result);
+		identical &= i % 2 == 0 || !result; // (Any cut is missing something.)
+	}
+	std::printf("20000 broken copies, (%zu rejected)\n", rejected);
+
+	std::printf("output %s\n", identical ? "identical" : "DIFFERS");
+	return !identical;
+}
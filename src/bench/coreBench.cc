@@ -0,0 +1,100 @@
+#include "../parsers.hh"
+#include "../renderer.hh"
+#include "bench.hh"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The core's hot paths, timed against libsketch.a the way a native
+// program would use it: parsing both text formats, flattening, drawing
+// into a plain buffer, and printing. Each is timed in rounds long enough
+// to dwarf the clock, and the median round is reported, (with how far
+// the rounds spread, so a noisy run shows itself). The inputs are the
+// example sketch repeated, and its strokes again as a raw sketch.
+
+constexpr unsigned W = 800, H = 600;
+constexpr PixelFormat ARGB8888 {0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000};
+
+struct Timing { double ms, spread; };
+
+template <typename F>
+auto timed(F&& f) -> Timing {
+	// Enough calls a round for it to take ~20 ms, (at least one).
+	std::size_t n = 1;
+	while (msPerCall(n, f) * n < 20) n *= 2;
+	std::vector<double> rounds {};
+	for (int r=0; r<9; r++) rounds.push_back(msPerCall(n, f));
+	std::ranges::sort(rounds);
+	const double median = rounds[rounds.size()/2];
+	// (The middle half's range, so one preempted round doesn't count.)
+	return {median, (rounds[6] - rounds[2]) / median};
+}
+
+void report(const char* name, Timing t, std::size_t bytes = 0) {
+	std::printf("%-20s %12.3f ms/op  ±%4.1f%%", name, t.ms, t.spread * 100);
+	if (bytes) std::printf(" %8.1f MB/s", bytes / (t.ms * 1e3));
+	std::printf("\n");
+}
+
+int main(int argc, char** argv) {
+	const std::size_t copies = argc > 1 ? std::atol(argv[1]) : 100;
+	std::ifstream input {"../tests/example file.hsc"};
+	if (!input) { std::printf("can't open the example sketch\n"); return 1; }
+	const auto example = SketchFormat::parse(std::string {std::istreambuf_iterator<char> {input}, {}});
+	if (!example) { std::printf("parse error in the example\n"); return 1; }
+
+	Sketch sketch {};
+	for (std::size_t i=0; i<copies; i++) {
+		for (const Element& e : example->elements) sketch.elements.push_back(e);
+	}
+	std::ostringstream os;
+	os << sketch;
+	const std::string text = os.str();
+
+	// (Raw points can't be negative, or past 2 digits.)
+	FlatSketch flat = sketch.render();
+	for (auto& s : flat.strokes) for (auto& p : s.points) {
+		p.x = std::clamp(p.x, 0, 36*36-1), p.y = std::clamp(p.y, 0, 36*36-1);
+	}
+	std::ostringstream rawOs;
+	RawFormat::print(rawOs, flat);
+	const std::string raw = rawOs.str();
+
+	// Everything has to come back out the way it went in.
+	bool same = true;
+	auto parsed = SketchFormat::parse(text);
+	auto rawParsed = RawFormat::parse(raw);
+	same &= parsed && rawParsed;
+	if (same) {
+		std::ostringstream again, rawAgain;
+		again << *parsed;
+		RawFormat::print(rawAgain, *rawParsed);
+		same &= again.str() == text && rawAgain.str() == raw;
+	}
+
+	std::vector<uint32_t> pixels (W*H);
+	Renderer renderer {pixels, W, H, ARGB8888};
+	const auto strokes = sketch.render().strokes;
+	std::size_t points = 0;
+	for (const auto& s : strokes) points += s.points.size();
+	std::printf("%zu elements, %zu strokes, %zu points, %.1f KiB text, %.1f KiB raw\n",
+		sketch.elements.size(), strokes.size(), points, text.size() / 1024.0, raw.size() / 1024.0);
+
+	report("SketchFormat::parse", timed([&] { SketchFormat::parse(text); }), text.size());
+	report("RawFormat::parse", timed([&] { RawFormat::parse(raw); }), raw.size());
+	report("Sketch::render", timed([&] { sketch.render(); }));
+	report("Renderer::displayRaw", timed([&] { renderer.clear(); renderer.displayRaw(strokes); }));
+	std::string printed {};
+	report("operator<<", timed([&] {
+		std::ostringstream out;
+		out << sketch;
+		printed = out.str();
+	}), text.size());
+
+	std::printf("round trips %s\n", same ? "identical" : "DIFFER");
+	return !same;
+}
@@ -0,0 +1,84 @@
+#include "../frameCache.hh"
+#include "../history.hh"
+#include "../renderer.hh"
+#include "../threadPool.hh"
+#include "bench.hh"
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Scrubbing back and forth through the last few undo states of a big
+// drawing, redrawing each one against copying it out of the cache.
+// Restored frames must match the redrawn ones exactly.
+
+constexpr unsigned W = 800, H = 600;
+constexpr PixelFormat ARGB8888 {0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000};
+
+auto randomStroke(std::mt19937& rng) -> Atom::Stroke {
+	std::uniform_int_distribution<int> x {0, W-1}, y {0, H-1}, step {-8, 8};
+	Atom::Stroke s {3, {}};
+	Atom::Stroke::Point p {x(rng), y(rng), 0.5};
+	for (int i=0; i<30; i++) {
+		s.points.push_back(p);
+		p = {p.x + step(rng), p.y + step(rng), 0.5};
+	}
+	return s;
+}
+
+int main() {
+	constexpr std::size_t Strokes = 3000, Scrub = 20, Passes = 5;
+
+	std::mt19937 rng {13};
+	History history {};
+	for (std::size_t i=0; i<Strokes; i++) history.commitStroke(randomStroke(rng));
+
+	std::vector<uint32_t> pixels (W*H), expected (W*H);
+	Renderer r {pixels, W, H, ARGB8888}, reference {expected, W, H, ARGB8888};
+	ThreadPool pool {};
+	FrameCache frames {};
+
+	// Back and forth over the last Scrub states, Passes times.
+	auto scrub = [&](auto&& visit) {
+		for (std::size_t pass=0; pass<Passes; pass++) {
+			for (std::size_t i=0; i<Scrub; i++) history.look_back(), visit();
+			for (std::size_t i=0; i<Scrub; i++) history.look_forward(), visit();
+		}
+	};
+	auto redraw = [&](Renderer& target) {
+		target.clear();
+		target.display(history.view(), target.screen(), pool);
+	};
+
+	const double tRedraw = msFor([&] { scrub([&] { redraw(r); }); });
+
+	const double tCached = msFor([&] {
+		scrub([&] {
+			if (!frames.restore(history.id(), pixels)) {
+				redraw(r);
+				frames.store(history.id(), pixels);
+			}
+		});
+	});
+
+	// Every state's in the cache by now.
+	const double tWarm = msFor([&] {
+		scrub([&] { frames.restore(history.id(), pixels); });
+	});
+
+	bool identical = true;
+	scrub([&] {
+		redraw(reference);
+		identical &= frames.restore(history.id(), pixels) && pixels == expected;
+	});
+
+	const auto stats = frames.stats();
+	const std::size_t steps = 2 * Scrub * Passes;
+	std::printf("redraw   %8.3f ms/step\n", tRedraw / steps);
+	std::printf("cached   %8.3f ms/step\n", tCached / steps);
+	std::printf("warm     %8.3f ms/step\n", tWarm / steps);
+	std::printf("frames   %8zu (%.1f KiB each, vs %zu KiB raw)\n", stats.frames,
+		stats.bytes / 1024.0 / stats.frames, W*H*sizeof(uint32_t) / 1024);
+	std::printf("hit rate %8.1f %%\n", 100.0 * stats.hits / (stats.hits + stats.misses));
+	std::printf("output %s\n", identical ? "identical" : "DIFFERS");
+	return !identical;
+}
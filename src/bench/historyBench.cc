@@ -0,0 +1,103 @@
+#include "../history.hh"
+#include "bench.hh"
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Memory held by the undo history after committing lots of strokes,
+// against the old way of keeping a whole copy of the sketch per state.
+// Also walks back through the states to check each one is intact, and
+// weighs a Brush's columns against the same strokes as Atom::Strokes.
+
+auto randomStroke(std::mt19937& rng) -> Atom::Stroke {
+	std::uniform_int_distribution<int> x {0, 799}, y {0, 599}, step {-6, 6};
+	Atom::Stroke s {3, {}};
+	Atom::Stroke::Point p {x(rng), y(rng), 0.5};
+	for (int i=0; i<20; i++) {
+		s.points.push_back(p);
+		p = {p.x + step(rng), p.y + step(rng), 0.5};
+	}
+	return s;
+}
+
+double MiB(std::size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+int main() {
+	// The old History: a full vector of strokes per state.
+	constexpr std::size_t CopiedStrokes = 500;
+	{
+		std::mt19937 rng {11};
+		const std::size_t before = liveBytes;
+		std::vector<std::vector<Atom::Stroke>> states {{}};
+		const double t = msFor([&] {
+			for (std::size_t i=0; i<CopiedStrokes; i++) {
+				auto next = states.back();
+				next.push_back(randomStroke(rng));
+				states.push_back(std::move(next));
+			}
+		});
+		std::printf("%-12s %6zu strokes %10.2f MiB %10.2f ms\n",
+			"full copies", CopiedStrokes, MiB(liveBytes - before), t);
+	}
+
+	bool intact = true;
+	for (std::size_t strokes : {CopiedStrokes, 10'000uz}) {
+		std::mt19937 rng {11};
+		const std::size_t before = liveBytes;
+		History history {};
+		std::vector<Atom::Stroke::Point> firsts {};
+		const double t = msFor([&] {
+			for (std::size_t i=0; i<strokes; i++) {
+				Atom::Stroke s = randomStroke(rng);
+				firsts.push_back(s.points[0]);
+				history.commitStroke(s);
+			}
+		});
+		std::printf("%-12s %6zu strokes %10.2f MiB %10.2f ms\n",
+			"persistent", strokes, MiB(liveBytes - before), t);
+
+		// State i has exactly the first i strokes.
+		for (std::size_t i=strokes; i>0; i--, history.look_back()) {
+			const auto& elements = history.view().elements;
+			const auto& atoms = std::get<Brush>(elements.back()).atoms;
+			intact &= elements.size() == 1 && atoms.size() == i
+			&&        atoms[i-1].x[0] == firsts[i-1].x
+			&&        atoms[i-1].y[0] == firsts[i-1].y;
+		}
+		history.look_back();
+		intact &= history.view().elements.empty();
+	}
+
+	// The same strokes both ways, and both read back the same.
+	{
+		constexpr std::size_t Strokes = 10'000;
+		std::mt19937 rng {11};
+		std::vector<Atom::Stroke> strokes {};
+		const std::size_t before = liveBytes;
+		for (std::size_t i=0; i<Strokes; i++) strokes.push_back(randomStroke(rng));
+		const std::size_t points = liveBytes - before;
+
+		const std::size_t between = liveBytes;
+		StrokeAtoms columns {};
+		for (const Atom::Stroke& s : strokes) columns.push_back(s);
+		const std::size_t packed = liveBytes - between;
+
+		for (std::size_t i=0; i<Strokes; i++) {
+			const Atom::Stroke s {columns[i]};
+			intact &= s.diameter == strokes[i].diameter && s.points.size() == strokes[i].points.size();
+			for (std::size_t j=0; j<s.points.size(); j++) {
+				intact &= s.points[j].x == strokes[i].points[j].x && s.points[j].y == strokes[i].points[j].y;
+			}
+		}
+		std::printf("%-12s %6zu strokes %10.2f MiB\n", "points", Strokes, MiB(points));
+		std::printf("%-12s %6zu strokes %10.2f MiB %9.1fx smaller\n", "columns", Strokes, MiB(packed), double(points) / packed);
+
+		// Past 16 bits clamps, rather than wrapping around.
+		StrokeAtoms far {};
+		far.push_back({3, {{40'000, -40'000, 1.0}}});
+		intact &= far[0].x[0] == INT16_MAX && far[0].y[0] == INT16_MIN;
+	}
+
+	std::printf("states %s\n", intact ? "intact" : "CORRUPTED");
+	return !intact;
+}
@@ -0,0 +1,182 @@
+#include "../journal.hh"
+#include "../parsers.hh"
+#include "bench.hh"
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+
+// Journals a long random session, (strokes with undos and redos mixed
+// in), then replays it from memory and from a file, and checks the
+// rebuilt History matches the live one state for state, ids, undo and
+// redo included. Also replays a journal that's been cut off mid-record,
+// like after a crash, and one checkpointed right after replaying, the
+// way startup does. Checkpoints keep only so many undos and redos, so
+// past that only the states kept have to match.
+
+auto randomStroke(std::mt19937& rng) -> Atom::Stroke {
+	std::uniform_int_distribution<int> x {0, 799}, y {0, 599}, step {-6, 6}, p {0, 1295};
+	Atom::Stroke s {3, {}};
+	for (int i=0, px=x(rng), py=y(rng); i<20; i++) {
+		s.points.push_back({px, py, p(rng) / 1295.0});
+		px += step(rng), py += step(rng);
+	}
+	return s;
+}
+
+auto print(const Sketch& sketch) -> std::string {
+	std::ostringstream os {};
+	SketchFormat::print(os, sketch);
+	return os.str();
+}
+
+// Elements plus brush strokes, (cheaper than printing every state).
+auto count(const Sketch& sketch) -> std::size_t {
+	std::size_t n = sketch.elements.size();
+	for (const Element& e : sketch.elements) {
+		if (auto* brush = std::get_if<Brush>(&e)) n += brush->atoms.size();
+	}
+	return n;
+}
+
+// How many undos (or redos) there are from the viewed state.
+auto reach(History h, void (History::*step)()) -> std::size_t {
+	std::size_t n = 0;
+	for (std::size_t id = h.id(); ; n++) {
+		(h.*step)();
+		if (h.id() == id) return n;
+		id = h.id();
+	}
+}
+
+// The replayed History a against the live one b: viewing the same
+// state, and undo and redo walking the same states with the same ids
+// as far as a goes, (every 50th printed in full). The next state has
+// to get the same id in both, too.
+bool sameHistory(History a, History b) {
+	if (a.id() != b.id()) return false;
+	const std::size_t back = reach(a, &History::look_back);
+	const std::size_t forward = reach(a, &History::look_forward);
+	if (back > reach(b, &History::look_back) || forward > reach(b, &History::look_forward)) return false;
+	bool ok = true;
+	auto compare = [&](std::size_t step) {
+		ok &= a.id() == b.id() && count(a.view()) == count(b.view());
+		if (step % 50 == 0) ok &= print(a.view()) == print(b.view());
+	};
+	for (std::size_t i=0; i<back; i++) compare(i), a.look_back(), b.look_back();
+	for (std::size_t i=0; i<back+forward; i++) compare(i), a.look_forward(), b.look_forward();
+	compare(0);
+	a.commitStroke({}), b.commitStroke({});
+	return ok && a.id() == b.id();
+}
+
+// A checkpoint has to keep as many undos and redos as it's meant to,
+// (or all of them, if there are fewer).
+bool keepsEnough(const History& replayed, const History& live) {
+	const std::size_t Keeps = Journal::CheckpointKeeps;
+	return reach(replayed, &History::look_back) >= std::min(reach(live, &History::look_back), Keeps)
+	&&     reach(replayed, &History::look_forward) >= std::min(reach(live, &History::look_forward), Keeps);
+}
+
+auto records(std::string_view journal, std::string_view kind) -> std::size_t {
+	std::size_t n = journal.starts_with(kind);
+	for (std::size_t i = journal.find("\n"); i != journal.npos; i = journal.find("\n", i+1)) {
+		n += journal.substr(i+1).starts_with(kind);
+	}
+	return n;
+}
+
+int main() {
+	constexpr std::size_t Steps = 5000;
+	const char* path = "journalBench.journal";
+	std::remove(path);
+
+	MemorySink memory {};
+	FileSink file {path};
+	Journal toMemory {memory}, toFile {file};
+	History live {};
+
+	std::mt19937 rng {12};
+	double tJournal = 0, tPrint = 0;
+	for (std::size_t i=0; i<Steps; i++) {
+		const unsigned op = rng() % 10;
+		tJournal += msFor([&] {
+			for (Journal* j : {&toMemory, &toFile}) {
+				if (op == 0) j->undo();
+				if (op == 1) j->redo();
+				if (j->wantsCheckpoint()) j->checkpoint(live);
+			}
+		});
+		if (op == 0) live.look_back();
+		if (op == 1) live.look_forward();
+		if (op >= 2) {
+			Atom::Stroke s = randomStroke(rng);
+			live.commitStroke(s);
+			tJournal += msFor([&] {
+				toMemory.commitStroke(s);
+				toFile.commitStroke(s);
+			});
+		}
+		// What saving the whole document every time would cost.
+		if (i % 100 == 0) tPrint += 100 * msFor([&] { print(live.view()); });
+	}
+
+	// End on a stroke, for the cut-off replay below.
+	const Atom::Stroke last = randomStroke(rng);
+	live.commitStroke(last);
+	toMemory.commitStroke(last);
+	toFile.commitStroke(last);
+
+	const std::string expected = print(live.view());
+	bool ok = true;
+
+	History fromMemory {};
+	const double tReplay = msFor([&] { fromMemory = Journal::replay(memory.contents); });
+	ok &= print(fromMemory.view()) == expected;
+	ok &= sameHistory(fromMemory, live) && keepsEnough(fromMemory, live);
+
+	std::ifstream in {path, std::ios::binary};
+	std::string onDisk {std::istreambuf_iterator<char> {in}, {}};
+	ok &= onDisk == memory.contents;
+	ok &= sameHistory(Journal::replay(onDisk), live);
+
+	// Cut mid-way into the last stroke: everything before it survives.
+	History cut = Journal::replay(std::string_view {memory.contents}.substr(0, memory.contents.size() - 10));
+	History before = live;
+	before.look_back();
+	ok &= print(cut.view()) == print(before.view());
+
+	// Restarted a few undos in, then checkpointed straight away: the
+	// redos and everything before the checkpoint are still there.
+	for (int i=0; i<3; i++) live.look_back(), toMemory.undo();
+	MemorySink restarted {};
+	Journal {restarted}.checkpoint(Journal::replay(memory.contents));
+	ok &= sameHistory(Journal::replay(restarted.contents), live);
+
+	// However long the session, a checkpoint is one sketch and the
+	// strokes around the viewed state, (not every state there's been,
+	// nor a copy of the sketch for each one pushed whole). Pushes stop
+	// it, so this one goes back to the last push and no further.
+	History pasted {};
+	for (std::size_t i=0; i<3000; i++) {
+		if (i % 500 == 0) pasted.push(live.view());
+		else pasted.commitStroke(randomStroke(rng));
+	}
+	MemorySink compact {};
+	Journal {compact}.checkpoint(pasted);
+	const std::size_t strokes = records(compact.contents, "s ");
+	ok &= records(compact.contents, "c ") == 1 && strokes == 499;
+	ok &= sameHistory(Journal::replay(compact.contents), pasted);
+	ok &= compact.contents.size() < print(pasted.view()).size() * 11/10;
+
+	std::printf("journal size     %10zu bytes\n", memory.contents.size());
+	std::printf("document size    %10zu bytes\n", expected.size());
+	std::printf("journaling       %10.2f ms total (both sinks)\n", tJournal);
+	std::printf("print every step %10.2f ms total (estimated)\n", tPrint);
+	std::printf("replay           %10.2f ms\n", tReplay);
+	std::printf("checkpoint       %10zu bytes, %zu strokes since a paste\n", compact.contents.size(), strokes);
+	std::printf("replay %s\n", ok ? "matches" : "DIFFERS");
+	std::remove(path);
+	return !ok;
+}
@@ -0,0 +1,132 @@
+#include "../lazyIndex.hh"
+#include "bench.hh"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Opening a big sketch as an Index, against parsing all of it. What
+// it decodes has to match the plain parse exactly, whether visited in
+// full, culled to a corner, or squeezed through a tiny budget. Broken
+// copies must fail somewhere if and only if the parse does, and with
+// the same error once the index itself opens.
+
+auto randomElement(std::mt19937& rng) -> Element {
+	// Scattered over a canvas 10 screens wide by 10 high, each element
+	// keeping to a patch of it.
+	std::uniform_int_distribution<int> x {0, 7999}, y {0, 5999}, near {-50, 50}, step {-6, 6}, length {5, 60};
+	std::uniform_real_distribution<double> pressure {0, 1};
+	if (rng() % 50 == 0) return Marker {{{"Note " + std::to_string(rng() % 100)}, {}}};
+	Brush brush {};
+	const int cx = x(rng), cy = y(rng);
+	for (int i=0; i<8; i++) {
+		Atom::Stroke s {3, {}};
+		Atom::Stroke::Point p {cx + near(rng), cy + near(rng), pressure(rng)};
+		for (int j=length(rng); j>0; j--) {
+			s.points.push_back(p);
+			p = {p.x + step(rng), p.y + step(rng), pressure(rng)};
+		}
+		brush.atoms.push_back(s);
+	}
+	if (rng() % 4 == 0) brush.modifiers.push_back(Mod::Affine {{1,0,40, 0,1,0, 0,0,1}});
+	return brush;
+}
+
+auto printed(const Sketch& sketch) -> std::string {
+	std::ostringstream os;
+	SketchFormat::print(os, sketch);
+	return os.str();
+}
+
+using Point = StrokeVisitor::Point;
+
+// Hash of every stroke streamed, (only keeping those inside clip,
+// if it's given).
+struct Hashing final : StrokeVisitor {
+	std::optional<std::pair<Point,Point>> clip {};
+	uint64_t h = 0, points = 0;
+
+	bool wants(Point lo, Point hi) override {
+		return !clip || (lo.x <= clip->second.x && clip->first.x <= hi.x
+		&&               lo.y <= clip->second.y && clip->first.y <= hi.y);
+	}
+	void beginStroke() override { add(~0ull); }
+	void point(Point p) override { add(uint64_t(p.x) << 32 ^ uint32_t(p.y)), points++; }
+	void add(uint64_t x) { h = (h ^ x) * 0x9e3779b97f4a7c15, h ^= h >> 32; }
+};
+
+int main(int argc, char** argv) {
+	const std::size_t count = argc > 1 ? std::atol(argv[1]) : 20'000;
+	std::mt19937 rng {20};
+	std::vector<Element> elements {};
+	for (std::size_t i=0; i<count; i++) elements.push_back(randomElement(rng));
+	const std::string text = "% Generated\n" + printed(Sketch {elements});
+	std::printf("%zu elements, %.1f MiB of text\n", count, text.size() / (1024.0 * 1024.0));
+
+	auto expected = SketchFormat::parse(text);
+	if (!expected) { std::printf("parse error %d at %zu:%zu\n", int(expected.error().type), expected.error().pos.row, expected.error().pos.col); return 1; }
+	const double parse = msPerCall(3, [&] { SketchFormat::parse(text); });
+	auto index = SketchFormat::index(text);
+	const double open = msPerCall(3, [&] { index = SketchFormat::index(text); });
+	if (!index) { std::printf("index error %d\n", int(index.error().type)); return 1; }
+	std::printf("%-8s %10.2f ms\n%-8s %10.2f ms %6.1fx\n", "parse", parse, "index", open, parse/open);
+
+	bool identical = index->size() == expected->elements.size();
+	auto sketch = index->sketch();
+	identical &= sketch && printed(*sketch) == printed(*expected);
+
+	// Everything, then just the top left screen's worth, which should
+	// only decode what's in it, (once the boxes are known).
+	auto compare = [&](std::optional<std::pair<Point,Point>> clip, const char* name) {
+		Hashing a {}, b {};
+		a.clip = b.clip = clip;
+		expected->visit(a);
+		index->resetStats();
+		const double t = msPerCall(1, [&] { identical &= !index->visit(b); });
+		identical &= a.h == b.h && a.points == b.points;
+		const auto stats = index->stats();
+		std::printf("%-14s %8.2f ms %8zu points %6zu decodes %6zu evictions %8.1f KiB held\n",
+			name, t, b.points, stats.decodes, stats.evictions, stats.bytes / 1024.0);
+	};
+	const std::pair<Point,Point> screen {{0,0}, {799,599}};
+	index->clear();
+	compare(std::nullopt, "all");
+	index->clear();
+	compare(screen, "screen");
+	compare(screen, "screen again");
+	index->setBudget(1 << 20);
+	compare(std::nullopt, "all, 1 MiB");
+	compare(screen, "screen, 1 MiB");
+
+	// Broken at random: if the index opens, decoding it all, (or drawing
+	// it), has to give exactly what parsing does.
+	std::size_t failures = 0, early = 0;
+	const std::string small = printed(Sketch {{elements.begin(), elements.begin()+200}});
+	for (int i=0; i<500; i++) {
+		std::string broken = small;
+		const std::size_t at = rng() % broken.size();
+		switch (rng() % 3) {
+			case 0: broken.erase(at, 1); break;
+			case 1: broken.insert(at, 1, ",;[]()%\n 'Z"[rng() % 11]); break;
+			case 2: broken.resize(at); break;
+		}
+		auto a = SketchFormat::parse(broken);
+		auto b = SketchFormat::index(broken);
+		failures += !a, early += !b;
+		if (!b) { identical &= !a; continue; }
+		// Drawing it has to say so if any of it's broken, (and where).
+		Hashing v {};
+		auto drawn = b->visit(v);
+		identical &= a ? !drawn
+		: drawn && a.error().type == drawn->type && a.error().pos == drawn->pos;
+		auto c = b->sketch();
+		identical &= a ? c && printed(*a) == printed(*c)
+		: !c && a.error().type == c.error().type && a.error().pos == c.error().pos;
+	}
+	std::printf("500 broken sketches, (%zu errors, %zu found opening)\n", failures, early);
+
+	std::printf("output %s\n", identical ? "identical" : "DIFFERS");
+	return !identical;
+}
@@ -0,0 +1,44 @@
+#include "../parsers.hh"
+#include "bench.hh"
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Heap traffic from parsing each sample sketch, (the example file by
+// default, or any given), counted per parse and per stroke point.
+
+int main(int argc, char** argv) {
+	std::vector<const char*> paths {argv+1, argv+argc};
+	if (paths.empty()) paths.push_back("../tests/example file.hsc");
+
+	bool ok = true;
+	for (const char* path : paths) {
+		std::ifstream input {path};
+		if (!input) { std::printf("can't open %s\n", path); return 1; }
+		std::string text {std::istreambuf_iterator<char> {input}, {}};
+
+		auto sketch = SketchFormat::parse(text);
+		if (!sketch) { std::printf("%s: parse error\n", path); ok = false; continue; }
+		std::size_t points = 0;
+		for (const Element& e : sketch->elements) std::visit([&](const auto& e) {
+			if constexpr (requires { e.atoms.begin()->points; }) {
+				for (const auto& s : e.atoms) points += s.points.size();
+			}
+			else if constexpr (requires { (*e.atoms.begin()).size(); }) {
+				for (const auto& s : e.atoms) points += s.size();
+			}
+		}, e);
+
+		constexpr std::size_t Runs = 50;
+		const std::size_t count0 = allocations, bytes0 = allocated;
+		const double t = msPerCall(Runs, [&] { ok &= bool(SketchFormat::parse(text)); });
+		const double count = double(allocations - count0) / Runs;
+		const double bytes = double(allocated - bytes0) / Runs;
+
+		std::printf("%s: %zu elements, %zu points\n", path, sketch->elements.size(), points);
+		std::printf("  %8.2f ms %10.0f allocations %10.0f KiB %8.3f allocations/point\n",
+			t, count, bytes/1024, count/std::max(points, 1uz));
+	}
+	return !ok;
+}
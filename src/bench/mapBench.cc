@@ -0,0 +1,80 @@
+#include "../mappedFile.hh"
+#include "../parsers.hh"
+#include "bench.hh"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Loading a big sketch file the old way, (copied through an
+// istreambuf_iterator into a string, then parsed), against parsing it
+// where it's mapped. Both must give the same sketch, and the mapping
+// has to stay alive for as long as the sketch does.
+
+auto randomElement(std::mt19937& rng) -> Element {
+	std::uniform_int_distribution<int> x {0, 799}, y {0, 599}, step {-6, 6};
+	std::uniform_real_distribution<double> pressure {0, 1};
+	Brush brush {};
+	for (int i=0; i<8; i++) {
+		Atom::Stroke s {3, {}};
+		Atom::Stroke::Point p {x(rng), y(rng), pressure(rng)};
+		for (int j=0; j<40; j++) {
+			s.points.push_back(p);
+			p = {p.x + step(rng), p.y + step(rng), pressure(rng)};
+		}
+		brush.atoms.push_back(s);
+	}
+	return brush;
+}
+
+auto printed(const Sketch& sketch) -> std::string {
+	std::ostringstream os;
+	SketchFormat::print(os, sketch);
+	return os.str();
+}
+
+int main(int argc, char** argv) {
+	const std::size_t count = argc > 1 ? std::atol(argv[1]) : 20'000;
+	const char* path = "mapBench.hsc";
+	{
+		std::mt19937 rng {19};
+		std::vector<Element> elements {};
+		for (std::size_t i=0; i<count; i++) elements.push_back(randomElement(rng));
+		std::ofstream {path, std::ios::binary} << Sketch {elements};
+	}
+
+	std::string copied {};
+	const double tCopy = msFor([&] {
+		std::ifstream input {path, std::ios::binary};
+		copied = {std::istreambuf_iterator<char> {input}, {}};
+	});
+	auto fromCopy = SketchFormat::parse(copied);
+	const double tCopyParse = msFor([&] { fromCopy = SketchFormat::parse(copied); });
+
+	std::shared_ptr<const MappedFile> file {};
+	const double tMap = msFor([&] { file = MappedFile::open(path); });
+	if (!file || !fromCopy) { std::printf("can't load %s\n", path); return 1; }
+	auto fromMap = SketchFormat::parse(file);
+	const double tMapParse = msFor([&] { fromMap = SketchFormat::parse(file); });
+
+	std::printf("%zu elements, %.1f MiB\n", count, copied.size() / (1024.0 * 1024.0));
+	std::printf("%-8s %8.1f ms read %8.1f ms parse\n", "copy", tCopy, tCopyParse);
+	std::printf("%-8s %8.1f ms map  %8.1f ms parse\n", "mmap", tMap, tMapParse);
+
+	// Only the sketch holds the mapping now.
+	std::weak_ptr<const MappedFile> mapping = file;
+	file.reset();
+	const bool alive = !mapping.expired() && mapping.lock()->view().size() == copied.size();
+	const bool same = fromMap && printed(*fromMap) == printed(*fromCopy);
+	fromMap = fromCopy;
+	const bool released = mapping.expired();
+	std::remove(path);
+
+	std::printf("output %s, mapping %s\n",
+		same ? "identical" : "DIFFERS",
+		alive && released ? "kept by the sketch" : "NOT KEPT");
+	return !(same && alive && released);
+}
@@ -0,0 +1,84 @@
+#include "../parsers.hh"
+#include "../threadPool.hh"
+#include "bench.hh"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Parsing a multi-megabyte sketch on 1/2/4/8 threads, against the
+// plain single-threaded parse, which it must match exactly. Broken
+// copies of the file must fail with the same error at the same spot.
+
+auto randomElement(std::mt19937& rng) -> Element {
+	std::uniform_int_distribution<int> x {0, 799}, y {0, 599}, step {-6, 6}, length {5, 60};
+	std::uniform_real_distribution<double> pressure {0, 1};
+	Brush brush {};
+	for (int i=0; i<8; i++) {
+		Atom::Stroke s {3, {}};
+		Atom::Stroke::Point p {x(rng), y(rng), pressure(rng)};
+		for (int j=length(rng); j>0; j--) {
+			s.points.push_back(p);
+			p = {p.x + step(rng), p.y + step(rng), pressure(rng)};
+		}
+		brush.atoms.push_back(s);
+	}
+	if (rng() % 4 == 0) brush.modifiers.push_back(Mod::Affine {{1,0,40, 0,1,0, 0,0,1}});
+	return brush;
+}
+
+auto printed(const Sketch& sketch) -> std::string {
+	std::ostringstream os;
+	SketchFormat::print(os, sketch);
+	return os.str();
+}
+
+int main(int argc, char** argv) {
+	const std::size_t count = argc > 1 ? std::atol(argv[1]) : 20'000;
+	std::mt19937 rng {18};
+	std::vector<Element> elements {};
+	for (std::size_t i=0; i<count; i++) elements.push_back(randomElement(rng));
+	const std::string text = "% Generated\n" + printed(Sketch {elements});
+	std::printf("%zu elements, %.1f MiB of text\n", count, text.size() / (1024.0 * 1024.0));
+
+	auto expected = SketchFormat::parse(text);
+	if (!expected) { std::printf("parse error %d at %zu:%zu\n", int(expected.error().type), expected.error().pos.row, expected.error().pos.col); return 1; }
+	const std::string expectedText = printed(*expected);
+	const double t0 = msPerCall(3, [&] { SketchFormat::parse(text); });
+	std::printf("%-10s %10.1f ms\n", "serial", t0);
+
+	bool identical = true;
+	for (std::size_t threads : {1, 2, 4, 8}) {
+		ThreadPool pool {threads};
+		decltype(expected) actual {};
+		const double t = msPerCall(3, [&] { actual = SketchFormat::parse(text, pool); });
+		identical &= actual && printed(*actual) == expectedText;
+		std::printf("%2zu thread%s %10.1f ms %6.2fx\n",
+			threads, threads > 1 ? "s" : " ", t, t0/t);
+	}
+
+	// Smaller sketches, (still a few runs each), broken at random:
+	// both have to fail the same way.
+	ThreadPool pool {4};
+	std::size_t failures = 0;
+	const std::string small = printed(Sketch {{elements.begin(), elements.begin()+200}});
+	for (int i=0; i<500; i++) {
+		std::string broken = small;
+		const std::size_t at = rng() % broken.size();
+		switch (rng() % 3) {
+			case 0: broken.erase(at, 1); break;
+			case 1: broken.insert(at, 1, ",;[]()%\n 'Z"[rng() % 11]); break;
+			case 2: broken.resize(at); break;
+		}
+		auto a = SketchFormat::parse(broken), b = SketchFormat::parse(broken, pool);
+		failures += !a;
+		identical &= a ? b && printed(*a) == printed(*b)
+		: !b && a.error().type == b.error().type && a.error().pos == b.error().pos;
+	}
+	std::printf("500 broken sketches, (%zu errors)\n", failures);
+
+	std::printf("output %s\n", identical ? "identical" : "DIFFERS");
+	return !identical;
+}
@@ -0,0 +1,113 @@
+#include "../parsers.hh"
+#include "bench.hh"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <streambuf>
+#include <string>
+
+// Parsing a big generated sketch all at once, against pulling its
+// elements one by one out of a stream. Peak heap for the stream must
+// stay about the size of one element, however long the file gets,
+// and both must read the same elements.
+
+// The same element over and over, "count" times, without ever holding
+// more than one copy of it, (so the file never has to exist at once).
+class RepeatBuf : public std::streambuf {
+	std::string element;
+	std::size_t left;
+	std::string chunk;
+
+	auto underflow() -> int_type override {
+		if (left == 0) return traits_type::eof();
+		chunk = element + (--left ? ",\n" : ";\n");
+		setg(chunk.data(), chunk.data(), chunk.data() + chunk.size());
+		return traits_type::to_int_type(chunk[0]);
+	}
+
+public:
+	RepeatBuf(std::string element, std::size_t count)
+	: element{std::move(element)}, left{count} {}
+};
+
+auto randomElement(std::mt19937& rng) -> std::string {
+	std::uniform_int_distribution<int> x {0, 799}, y {0, 599}, step {-6, 6};
+	std::uniform_real_distribution<double> pressure {0, 1};
+	Brush brush {};
+	for (int i=0; i<8; i++) {
+		Atom::Stroke s {3, {}};
+		Atom::Stroke::Point p {x(rng), y(rng), pressure(rng)};
+		for (int j=0; j<40; j++) {
+			s.points.push_back(p);
+			p = {p.x + step(rng), p.y + step(rng), pressure(rng)};
+		}
+		brush.atoms.push_back(s);
+	}
+	std::ostringstream os;
+	SketchFormat::print(os, Sketch {std::vector<Element> {brush}});
+	std::string text = os.str();
+	return text.substr(0, text.rfind(';'));
+}
+
+double MiB(std::size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+int main(int argc, char** argv) {
+	const std::size_t count = argc > 1 ? std::atol(argv[1]) : 20'000;
+	std::mt19937 rng {14};
+	const std::string element = randomElement(rng);
+	const std::size_t fileBytes = count * (element.size() + 2);
+	std::printf("%zu elements, %.1f MiB of text\n", count, MiB(fileBytes));
+
+	// Everything in memory: the text, then the whole sketch.
+	std::size_t wholeCount = 0;
+	{
+		std::string text {};
+		text.reserve(fileBytes);
+		for (std::size_t i=0; i<count; i++) {
+			text += element;
+			text += i+1 < count ? ",\n" : ";\n";
+		}
+		peakBytes = liveBytes.load();
+		const std::size_t before = liveBytes;
+		const double t = msFor([&] {
+			auto sketch = SketchFormat::parse(text);
+			if (sketch) wholeCount = sketch->elements.size();
+		});
+		std::printf("%-8s %10.1f ms %10.2f MiB peak\n",
+			"parse", t, MiB(peakBytes - before + text.size()));
+	}
+
+	// A stream, one element at a time, (each thrown away once read).
+	std::size_t streamCount = 0, streamPeak = 0;
+	bool same = true;
+	{
+		RepeatBuf buf {element, count};
+		std::istream input {&buf};
+		auto expected = SketchFormat::parse(element + ";");
+		if (!expected) { std::printf("parse error\n"); return 1; }
+		const uint64_t hash = contentHash(expected->elements[0]);
+		peakBytes = liveBytes.load();
+		const std::size_t before = liveBytes;
+		const double t = msFor([&] {
+			SketchFormat::Reader reader {input};
+			while (true) {
+				auto e = reader.next();
+				if (!e) { same = false; break; }
+				if (!*e) break;
+				streamCount++;
+				same &= contentHash(**e) == hash;
+			}
+		});
+		streamPeak = peakBytes - before;
+		std::printf("%-8s %10.1f ms %10.2f MiB peak\n",
+			"stream", t, MiB(streamPeak));
+	}
+
+	same &= wholeCount == count && streamCount == count;
+	// A few chunks of input at most, whatever the file size.
+	const bool bounded = streamPeak < 16 * SketchFormat::Reader::ChunkSize;
+	std::printf("elements %s\n", same ? "identical" : "DIFFER");
+	std::printf("stream memory %s\n", bounded ? "bounded" : "UNBOUNDED");
+	return !(same && bounded);
+}
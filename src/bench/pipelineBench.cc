@@ -0,0 +1,103 @@
+#include "../history.hh"
+#include "../parsers.hh"
+#include "../renderer.hh"
+#include "../threadPool.hh"
+#include "bench.hh"
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Flattening a sketch then drawing it, against streaming it straight
+// into the renderer. Both must draw the same pixels, and the stream
+// must not touch the heap once the renderer's buffers are warm. Also
+// draws a session stroke by stroke through a FlattenCache, which has to
+// flatten just the new stroke each commit, and nothing to draw the same
+// state again or undo and redo.
+
+constexpr unsigned W = 800, H = 600;
+constexpr PixelFormat ARGB8888 {0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000};
+
+auto randomStroke(std::mt19937& rng) -> Atom::Stroke {
+	std::uniform_int_distribution<int> x {0, W-1}, y {0, H-1}, step {-8, 8};
+	Atom::Stroke s {3, {}};
+	Atom::Stroke::Point p {x(rng), y(rng), 0.5};
+	for (int i=0; i<30; i++) {
+		s.points.push_back(p);
+		p = {p.x + step(rng), p.y + step(rng), 0.5};
+	}
+	return s;
+}
+
+int main(int argc, char** argv) {
+	const char* path = argc > 1 ? argv[1] : "../tests/example file.hsc";
+	std::ifstream input {path};
+	if (!input) { std::printf("can't open %s\n", path); return 1; }
+	std::string text {std::istreambuf_iterator<char> {input}, {}};
+
+	auto sketch = SketchFormat::parse(text);
+	if (!sketch) { std::printf("parse error\n"); return 1; }
+
+	std::vector<uint32_t> expected (W*H), actual (W*H);
+	Renderer reference {expected, W, H, ARGB8888}, r {actual, W, H, ARGB8888};
+	ThreadPool pool {};
+
+	const double tFlat = msPerCall(20, [&] {
+		reference.clear();
+		reference.displayRaw(sketch->render().strokes);
+	});
+
+	const double tStream = msPerCall(20, [&] {
+		r.clear();
+		r.display(*sketch, r.screen());
+	});
+	bool identical = actual == expected;
+
+	const double tTiled = msPerCall(20, [&] {
+		r.clear();
+		r.display(*sketch, r.screen(), pool);
+	});
+	identical &= actual == expected;
+
+	const std::size_t before = allocations;
+	r.clear();
+	r.display(*sketch, r.screen());
+	const std::size_t streamed = allocations - before;
+
+	std::printf("%-16s %8.2f ms\n", "flatten + draw", tFlat);
+	std::printf("%-16s %8.2f ms %6.2fx\n", "stream", tStream, tFlat/tStream);
+	std::printf("%-16s %8.2f ms %6.2fx\n", "stream (tiled)", tTiled, tFlat/tTiled);
+	std::printf("allocations per streamed frame: %zu\n", streamed);
+
+	// A session drawn stroke by stroke, each commit's frame then drawn
+	// again, and the last few strokes undone and redone.
+	constexpr std::size_t Commits = 1000;
+	std::mt19937 rng {7};
+	History history {};
+	history.push(*sketch);
+	FlattenCache cache {};
+	history.view().renderInstances(cache);
+	std::size_t worstMisses = 0, worstStrokes = 0, againMisses = 0;
+	auto frame = [&] {
+		cache.resetStats();
+		auto instances = history.view().renderInstances(cache);
+		return cache.stats();
+	};
+	const double tCommit = msPerCall(Commits, [&] {
+		history.commitStroke(randomStroke(rng));
+		const auto stats = frame();
+		worstMisses = std::max(worstMisses, stats.misses);
+		worstStrokes = std::max(worstStrokes, stats.strokes);
+		againMisses += frame().misses;
+	});
+	for (int i=0; i<20; i++) history.look_back(), againMisses += frame().misses;
+	for (int i=0; i<20; i++) history.look_forward(), againMisses += frame().misses;
+	const bool incremental = worstMisses == 1 && worstStrokes == 1 && againMisses == 0;
+	identical &= history.view().render(cache).strokes == history.view().render().strokes;
+
+	std::printf("%-16s %8.3f ms per commit, (at most %zu flattened, %zu misses redrawn)\n",
+		"cached frames", tCommit, worstStrokes, againMisses);
+	std::printf("output %s\n", identical ? "identical" : "DIFFERS");
+	return !identical || streamed != 0 || !incremental;
+}
@@ -0,0 +1,194 @@
+#include "../renderer.hh"
+#include "../graphics.hh"
+#include "bench.hh"
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <bit>
+#include <vector>
+
+// Compares Renderer::drawLine against the old bounding-box loop,
+// which is kept here (verbatim) as the reference implementation,
+// and SDFlineCoverage against per-pixel calls to SDFline.
+
+constexpr unsigned W = 800, H = 600;
+
+uint32_t mapRGB(Col3 c) { return 0xFF000000 | c.r<<16 | c.g<<8 | c.b; }
+Col3 getRGB(uint32_t p) { return {uint8_t(p>>16), uint8_t(p>>8), uint8_t(p)}; }
+
+constexpr PixelFormat ARGB8888 {0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000};
+constexpr PixelFormat RGBA8888 {0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF};
+// No packed path for this one, so it takes the per-channel fallback.
+constexpr PixelFormat GRAB8888 {0x00FF0000, 0xFF000000, 0x000000FF, 0x0000FF00};
+
+// Called through std::function, like Renderer used to.
+const std::function<uint32_t(Col3)> MapRGB = mapRGB;
+const std::function<Col3(uint32_t)> GetRGB = getRGB;
+
+void drawLineBox(std::span<uint32_t> pixels, Vec2 a, Vec2 b) {
+	auto [xMin, xMax] = std::minmax(a.x, b.x);
+	auto [yMin, yMax] = std::minmax(a.y, b.y);
+	const Real x0 = max(  0, xMin-2);
+	const Real y0 = max(  0, yMin-2);
+	const Real x1 = min(W-1, xMax+2);
+	const Real y1 = min(H-1, yMax+2);
+
+	Vec2 xy;
+	for (Real y=y0; y<=y1; y+=1) {
+	for (Real x=x0; x<=x1; x+=1) {
+		xy = Vec2 {x + 0.5, y + 0.5};
+		uint8_t c = 255*clamp(SDFline(xy, a, b) - 1, 0, 1);
+		auto& pixel = pixels[y*W + x];
+		Col3 cOld = GetRGB(pixel);
+		pixel = MapRGB({
+			(cOld.r < c) ? cOld.r : c,
+			(cOld.g < c) ? cOld.g : c,
+			(cOld.b < c) ? cOld.b : c,
+		});
+	} }
+}
+
+uint8_t coverageScalar(Vec2 p, Vec2 a, Vec2 b) {
+	return 255*clamp(SDFline(p, a, b) - 1, 0, 1);
+}
+
+// Differential test of the row kernel on random segments and rows.
+int checkKernel() {
+	std::mt19937 rng {36};
+	std::uniform_real_distribution<Real> coord {-50, 850};
+	std::uniform_int_distribution<int> len {0, 64};
+	std::uniform_int_distribution<int> pick {0, 3};
+
+	int maxDiff = 0;
+	uint8_t row[64];
+	for (int t=0; t<200000; t++) {
+		Vec2 a {std::floor(coord(rng)), std::floor(coord(rng))};
+		Vec2 b {std::floor(coord(rng)), std::floor(coord(rng))};
+		if (pick(rng) == 0) b = a; // Point case
+		if (pick(rng) == 0) b.y = a.y; // Horizontal
+		if (pick(rng) == 0) b.x = a.x; // Vertical
+
+		// Start near the segment so most pixels are covered.
+		Real x = std::floor(a.x) + len(rng) - 32 + 0.5;
+		Real y = std::floor(a.y) + len(rng) - 32 + 0.5;
+		std::size_t n = len(rng);
+
+		SDFlineCoverage(row, n, x, y, LineSDF {a, b});
+		for (std::size_t i=0; i<n; i++) {
+			int c = coverageScalar({x+i, y}, a, b);
+			maxDiff = std::max(maxDiff, std::abs(c - row[i]));
+		}
+	}
+	return maxDiff;
+}
+
+void benchKernel() {
+	const Vec2 a {100, 100}, b {700, 140};
+	const LineSDF line {a, b};
+	uint8_t row[512];
+	volatile uint8_t sink;
+
+	double tScalar = nsPerCall(20000, [&] {
+		for (std::size_t i=0; i<512; i++) {
+			row[i] = coverageScalar({100.5+i, 120.5}, a, b);
+		}
+		sink = row[0];
+	});
+	double tKernel = nsPerCall(20000, [&] {
+		SDFlineCoverage(row, 512, 100.5, 120.5, line);
+		sink = row[0];
+	});
+	(void)sink;
+
+	std::printf("%-16s %14.1f %14.1f %7.1fx\n",
+		"512px row", tScalar, tKernel, tScalar/tKernel);
+}
+
+// Whole frames, (clear + a few thousand strokes) for each blend path,
+// next to the old per-pixel std::function conversion for reference.
+int benchFrame() {
+	std::mt19937 rng {600};
+	std::uniform_int_distribution<int> x {0, W-1}, y {0, H-1}, step {-8, 8};
+	std::vector<Atom::FlatStroke> strokes (3000);
+	for (auto& s : strokes) {
+		Atom::FlatStroke::Point p {x(rng), y(rng)};
+		for (int i=0; i<20; i++) {
+			s.points.push_back(p);
+			p = {p.x + step(rng), p.y + step(rng)};
+		}
+	}
+
+	std::vector<uint32_t> buf (W*H);
+	std::printf("\n%-16s %14s %14s\n", "frame", "clear (us)", "strokes (us)");
+
+	double tOld = nsPerCall(50, [&] {
+		for (std::size_t i=0; i<W*H; i++) buf[i] = MapRGB({255,255,255});
+	});
+	std::printf("%-16s %14.1f %14s\n", "std::function", tOld/1000, "-");
+
+	std::vector<uint32_t> results[3];
+	const std::pair<const char*, PixelFormat> formats[] {
+		{"ARGB8888", ARGB8888}, {"RGBA8888", RGBA8888}, {"GRAB8888", GRAB8888},
+	};
+	for (std::size_t i=0; const auto& [name, format] : formats) {
+		Renderer r {buf, W, H, format};
+		double tClear = nsPerCall(50, [&] { r.clear(); });
+		double tDraw  = nsPerCall(5, [&] { r.clear(); r.displayRaw(strokes); });
+		std::printf("%-16s %14.1f %14.1f\n", name, tClear/1000, (tDraw-tClear)/1000);
+
+		// Strokes are grey, so compare one channel of each.
+		for (uint32_t p : buf) {
+			results[i].push_back((p & format.Bmask) >> std::countr_zero(format.Bmask));
+		}
+		i++;
+	}
+
+	return results[0] != results[1] || results[0] != results[2];
+}
+
+int main() {
+	struct Case { const char* name; Vec2 a, b; std::size_t n; };
+	const Case cases[] {
+		{"long diagonal",  {10,10}, {790,590},   200},
+		{"short",         {400,300}, {405,303}, 200000},
+		{"point",         {400,300}, {400,300}, 200000},
+	};
+
+	int maxDiff = 0;
+	std::printf("%-16s %14s %14s %8s\n", "segment", "box (ns)", "span (ns)", "speedup");
+
+	for (const Case& c : cases) {
+		std::vector<uint32_t> boxBuf (W*H), spanBuf (W*H);
+		Renderer r {spanBuf, W, H, ARGB8888};
+		r.clear();
+		std::ranges::fill(boxBuf, mapRGB({255,255,255}));
+
+		const Atom::FlatStroke stroke {{
+			{int(c.a.x), int(c.a.y)},
+			{int(c.b.x), int(c.b.y)},
+		}};
+
+		double tBox  = nsPerCall(c.n, [&] { drawLineBox(boxBuf, c.a, c.b); });
+		double tSpan = nsPerCall(c.n, [&] { r.displayRaw({&stroke, 1}); });
+
+		for (std::size_t i=0; i<W*H; i++) {
+			Col3 p = getRGB(boxBuf[i]), q = getRGB(spanBuf[i]);
+			maxDiff = std::max({maxDiff,
+				std::abs(p.r - q.r), std::abs(p.g - q.g), std::abs(p.b - q.b),
+			});
+		}
+
+		std::printf("%-16s %14.1f %14.1f %7.1fx\n", c.name, tBox, tSpan, tBox/tSpan);
+	}
+
+	std::printf("\n%-16s %14s %14s %8s\n", "kernel", "scalar (ns)", "simd (ns)", "speedup");
+	benchKernel();
+	int kernelDiff = checkKernel();
+	int formatDiff = benchFrame();
+
+	std::printf("\nmax difference: %d LSB (raster), %d LSB (kernel)\n",
+		maxDiff, kernelDiff);
+	if (formatDiff) std::printf("pixel formats disagree!\n");
+	return maxDiff > 1 || kernelDiff > 1 || formatDiff;
+}
@@ -0,0 +1,174 @@
+#include "../parsers.hh"
+#include "bench.hh"
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Scanning a big sketch against parsing it. The summary has to match
+// one counted up from the parsed sketch, and broken copies have to be
+// turned down by one exactly when they are by the other, with the same
+// error at the same place.
+
+auto randomElement(std::mt19937& rng) -> Element {
+	std::uniform_int_distribution<int> x {0, 7999}, y {0, 5999}, near {-50, 50}, step {-6, 6}, length {5, 60};
+	std::uniform_real_distribution<double> pressure {0, 1};
+	const int cx = x(rng), cy = y(rng);
+	switch (rng() % 20) {
+	case 0:
+		return Marker {{{"Note " + std::to_string(rng() % 100)}, MarkerModifiers (rng() % 2)}};
+	case 1: case 2: {
+		FlatStrokeAtoms atoms {};
+		for (int i=0; i<8; i++) {
+			Atom::FlatStroke s {};
+			for (int j=length(rng); j>0; j--) s.points.push_back({cx + near(rng), cy + near(rng)});
+			atoms.push_back(s);
+		}
+		if (rng() % 2) return Pencil {{atoms, {}}};
+		return Data {{atoms, {Mod::Array {3, {{1,0,20, 0,1,0, 0,0,1}}}}}};
+	}
+	default:
+		Brush brush {};
+		for (int i=0; i<8; i++) {
+			Atom::Stroke s {3, {}};
+			Atom::Stroke::Point p {cx + near(rng), cy + near(rng), pressure(rng)};
+			for (int j=length(rng); j>0; j--) {
+				s.points.push_back(p);
+				p = {p.x + step(rng), p.y + step(rng), pressure(rng)};
+			}
+			brush.atoms.push_back(s);
+		}
+		if (rng() % 4 == 0) brush.modifiers.push_back(Mod::Affine {{1,0,40, 0,1,0, 0,0,1}});
+		return brush;
+	}
+}
+
+auto printed(const Sketch& sketch) -> std::string {
+	std::ostringstream os;
+	SketchFormat::print(os, sketch);
+	return os.str();
+}
+
+// What scan() should give, counted the long way.
+auto expected(const Sketch& sketch) -> SketchFormat::Summary {
+	SketchFormat::Summary result {};
+	auto include = [&](int x, int y) {
+		auto& [lo, hi] = result.bounds;
+		lo = {std::min(lo.x, x), std::min(lo.y, y)};
+		hi = {std::max(hi.x, x), std::max(hi.y, y)};
+	};
+	for (const Element& element : sketch.elements) {
+		result.elements++;
+		result.types[element.index()]++;
+		std::visit([&]<typename T>(const T& e) {
+			if constexpr (HoldsStrokeAtoms<T>) {
+				for (const StrokeAtoms::View view : e.atoms) {
+					const Atom::Stroke s {view};
+					result.strokes++, result.points += s.points.size();
+					for (const auto& p : s.points) include(p.x, p.y);
+				}
+			}
+			else if constexpr (HoldsFlatStrokeAtoms<T>) {
+				for (const Atom::FlatStroke& s : e.atoms) {
+					result.strokes++, result.points += s.points.size();
+					for (const auto& p : s.points) include(p.x, p.y);
+				}
+			}
+		}, element);
+	}
+	return result;
+}
+
+bool operator==(const SketchFormat::Summary& a, const SketchFormat::Summary& b) {
+	return a.elements == b.elements && a.types == b.types
+	&&     a.strokes == b.strokes && a.points == b.points
+	&&     a.bounds == b.bounds;
+}
+
+// Both fail the same way, or both succeed with the same summary.
+bool agrees(std::string_view text) {
+	auto parsed = SketchFormat::parse(text);
+	auto scanned = SketchFormat::scan(text);
+	if (bool(parsed) != bool(scanned)) return false;
+	if (!parsed) {
+		return int(parsed.error().type) == int(scanned.error().type)
+		&&     parsed.error().pos == scanned.error().pos;
+	}
+	return *scanned == expected(*parsed);
+}
+
+int main(int argc, char** argv) {
+	const std::size_t count = argc > 1 ? std::atol(argv[1]) : 20'000;
+	std::mt19937 rng {24};
+	std::vector<Element> elements {};
+	for (std::size_t i=0; i<count; i++) elements.push_back(randomElement(rng));
+	const std::string text = printed(Sketch {elements});
+
+	bool same = true;
+	std::ifstream input {"../tests/example file.hsc"};
+	if (!input) { std::printf("can't open the example sketch\n"); return 1; }
+	same &= agrees(std::string {std::istreambuf_iterator<char> {input}, {}});
+	same &= agrees(text);
+
+	// Some of it again as if laid out by hand, with line breaks, tabs
+	// and comments between the atoms.
+	std::string handmade = printed(Sketch {{elements.begin(), elements.begin() + std::min(count, 2000uz)}});
+	for (std::size_t i=0; i<handmade.size(); i++) {
+		if (handmade[i] != ' ' || rng() % 8) continue;
+		handmade[i] = rng() % 2 ? '\t' : '\n';
+		if (handmade[i] == '\n' && rng() % 4 == 0) handmade.insert(i+1, "% A comment, (with [things] in it).\n");
+	}
+	same &= agrees(handmade);
+
+	const double parse = msPerCall(3, [&] { SketchFormat::parse(text); });
+	const double scan  = msPerCall(3, [&] { SketchFormat::scan(text); });
+	const auto summary = *SketchFormat::scan(text);
+	std::printf("%zu elements, %zu strokes, %zu points, %.1f MiB\n",
+		summary.elements, summary.strokes, summary.points, text.size() / (1024.0 * 1024.0));
+	std::printf("parse %10.2f ms %8.1f MB/s\n", parse, text.size() / (parse * 1000));
+	std::printf("scan  %10.2f ms %8.1f MB/s %6.1fx faster\n", scan, text.size() / (scan * 1000), parse/scan);
+
+	// Markers, then a Brush after them all. Each Marker's quick try has
+	// to give up at the Marker, not search on to the Brush, or scanning
+	// gets quadratic: 8x the Markers has to take about 8x as long.
+	auto markers = [&](std::size_t n) {
+		std::vector<Element> elements (n, Marker {{{"Note"}, {}}});
+		elements.push_back(randomElement(rng));
+		const std::string text = printed(Sketch {elements});
+		same &= agrees(text);
+		return msPerCall(3, [&] { SketchFormat::scan(text); }) / n;
+	};
+	const double few = markers(4000), many = markers(32'000);
+	std::printf("markers %8.2f us each, (%.2f us with 8x as many)\n", few * 1000, many * 1000);
+	same &= many < 2 * few;
+
+	// Broken copies of a few elements, with awkward chars put in, taken
+	// out, or swapped for others.
+	std::string small = printed(Sketch {{elements.begin(), elements.begin() + std::min(count, 12uz)}});
+	small.insert(small.find(",\n") + 2, "% A comment, (with [things] in it).\n");
+	constexpr std::string_view awkward = "'[](),;% \nZz0!-";
+	std::size_t rejected = 0, disagreed = 0;
+	for (int i=0; i<20'000; i++) {
+		std::string broken = small;
+		for (int edits = 1 + rng() % 2; edits > 0; edits--) {
+			const std::size_t at = rng() % broken.size();
+			const char c = awkward[rng() % awkward.size()];
+			switch (rng() % 3) {
+			case 0: broken[at] = c; break;
+			case 1: broken.insert(broken.begin() + at, c); break;
+			case 2: broken.erase(at, 1); break;
+			}
+		}
+		rejected += !SketchFormat::parse(broken);
+		disagreed += !agrees(broken);
+	}
+	std::printf("20000 broken copies, (%zu rejected, %zu disagreeing)\n", rejected, disagreed);
+	same &= disagreed == 0;
+
+	std::printf("results %s\n", same ? "identical" : "DIFFER");
+	return !same;
+}
@@ -0,0 +1,47 @@
+#include "../renderer.hh"
+#include "../threadPool.hh"
+#include "bench.hh"
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Tiled, multi-threaded rasterization at 1/2/4/8 threads against
+// the single-threaded path, which its output must match exactly.
+
+constexpr unsigned W = 800, H = 600;
+constexpr PixelFormat ARGB8888 {0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000};
+
+int main() {
+	std::mt19937 rng {64};
+	std::uniform_int_distribution<int> x {-20, W+20}, y {-20, H+20}, step {-12, 12};
+	std::vector<Atom::FlatStroke> strokes (5000);
+	for (auto& s : strokes) {
+		Atom::FlatStroke::Point p {x(rng), y(rng)};
+		for (int i=0; i<30; i++) {
+			s.points.push_back(p);
+			p = {p.x + step(rng), p.y + step(rng)};
+		}
+	}
+
+	std::vector<uint32_t> expected (W*H), actual (W*H);
+	Renderer reference {expected, W, H, ARGB8888};
+	reference.clear();
+	const double t0 = msPerCall(3, [&] { reference.displayRaw(strokes); });
+	std::printf("%-10s %10.2f ms\n", "untiled", t0);
+
+	bool identical = true;
+	for (std::size_t threads : {1, 2, 4, 8}) {
+		ThreadPool pool {threads};
+		Renderer r {actual, W, H, ARGB8888};
+		const double t = msPerCall(3, [&] {
+			r.clear();
+			r.displayRaw(strokes, r.screen(), pool);
+		});
+		identical &= actual == expected;
+		std::printf("%2zu thread%s %10.2f ms %6.2fx\n",
+			threads, threads > 1 ? "s" : " ", t, t0/t);
+	}
+
+	std::printf("output %s\n", identical ? "identical" : "DIFFERS");
+	return !identical;
+}
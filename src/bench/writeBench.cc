@@ -0,0 +1,192 @@
+#include "../parsers.hh"
+#include "bench.hh"
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Printing a big sketch with TextWriter, against the operator<<s it
+// replaced, (kept below), which it has to match byte for byte. Also
+// the heap traffic of each, and the same for the raw ".sketch" format.
+
+namespace Old
+{
+	void print(std::ostream& os, const StrokeModifiers& v) {
+		for (const Mod::Of_Stroke& mod : v) {
+			os << "\n\t";
+			std::visit(Util::Overloaded {
+				[&os](const Mod::Affine& a) {
+					os << "Affine [ ";
+					for (std::size_t i=0; i<9; i++) os << a.matrix[i] << " ";
+					os << "]";
+				},
+				[&os](const Mod::Array& a) {
+					os << "Array [ " << a.N << " Affine [ ";
+					for (std::size_t i=0; i<9; i++) os << a.transformation.matrix[i] << " ";
+					os << "] ]";
+				},
+			}, mod);
+		}
+	}
+
+	void print(std::ostream& os, const Element& element) {
+		std::visit(Util::Overloaded {
+			[&os](const Brush& e) {
+				os << "Brush [ ";
+				for (const StrokeAtoms::View s : e.atoms) {
+					os << Base36::toString<2,unsigned>(s.diameter) << " ";
+					for (std::size_t i=0; i<s.size(); i++) {
+						os << Base36::toString<3,signed>(int(s.x[i]))
+						   << Base36::toString<3,signed>(int(s.y[i])) << "\'"
+						   << Base36::toString<2,unsigned>(unsigned(s.pressure[i]))
+						   << (i+1 < s.size() ? "\'" : "");
+					}
+					os << " ";
+				}
+				os << "]";
+				print(os, e.modifiers);
+			},
+			[&os]<typename T>(const T& e) requires HoldsFlatStrokeAtoms<T> {
+				os << (std::is_same_v<T, Pencil> ? "Pencil [ " : "Data [ ");
+				for (Atom::FlatStroke s : e.atoms) {
+					for (std::size_t i = s.points.size(); const auto& p : s.points) {
+						os << Base36::toString<3,signed>(p.x)
+						   << Base36::toString<3,signed>(p.y) << (--i ? "\'" : "");
+					}
+					os << " ";
+				}
+				os << "]";
+				print(os, e.modifiers);
+			},
+			[&os](const Marker& e) {
+				os << "Marker (" << e.atoms.text << ")";
+				for (std::size_t i=0; i<e.modifiers.size(); i++) os << "\n\tUppercase [ ]";
+			},
+		}, element);
+	}
+
+	void print(std::ostream& os, const Sketch& sketch) {
+		for (std::size_t i = sketch.elements.size(); const Element& e : sketch.elements) {
+			print(os, e);
+			os << (--i ? ",\n" : "");
+		}
+		os << ";";
+	}
+
+	void printRaw(std::ostream& os, const FlatSketch& sketch) {
+		for (const auto& s : sketch.strokes) {
+			os << " ";
+			for (const auto& p : s.points) {
+				os << Base36::toString<2,unsigned>(p.x) << Base36::toString<2,unsigned>(p.y);
+			}
+		}
+	}
+}
+
+// Every kind of element, with awkward doubles in the modifiers.
+auto randomElement(std::mt19937& rng) -> Element {
+	std::uniform_int_distribution<int> x {-23328, 23327}, length {0, 60};
+	std::uniform_real_distribution<double> pressure {0, 1};
+	constexpr double awkward[] = {
+		0, -0.0, 1, -1, 0.5, 0.1, 1.0/3, 123456, 1234567, 1e-5, 1e-4,
+		-2.5e-7, 1e21, 6.02214076e23, std::numeric_limits<double>::denorm_min(),
+		std::numeric_limits<double>::max(), std::numeric_limits<double>::infinity(),
+	};
+	auto matrix = [&] {
+		std::array<double,9> m;
+		for (double& d : m) d = rng() % 2 ? awkward[rng() % std::size(awkward)] : pressure(rng) * 1000 - 500;
+		return m;
+	};
+	StrokeModifiers mods {};
+	for (int i=rng()%3; i>0; i--) {
+		if (rng() % 2) mods.push_back(Mod::Affine {matrix()});
+		else mods.push_back(Mod::Array {rng() % 20, matrix()});
+	}
+
+	switch (rng() % 4) {
+	case 0: {
+		Brush brush {};
+		for (int i=rng()%8; i>=0; i--) {
+			Atom::Stroke s {unsigned(rng() % 1296), {}};
+			for (int j=length(rng); j>0; j--) s.points.push_back({x(rng) % 32768, x(rng) % 32768, pressure(rng)});
+			brush.atoms.push_back(s);
+		}
+		brush.modifiers = mods;
+		return brush;
+	}
+	case 1: case 2: {
+		FlatStrokeAtoms atoms {};
+		for (int i=rng()%8; i>=0; i--) {
+			Atom::FlatStroke s {};
+			for (int j=length(rng); j>0; j--) s.points.push_back({x(rng), x(rng)});
+			atoms.push_back(s);
+		}
+		if (rng() % 2) return Pencil {{atoms, mods}};
+		return Data {{atoms, mods}};
+	}
+	default:
+		return Marker {{{"Marker " + std::to_string(rng())}, MarkerModifiers (rng() % 3)}};
+	}
+}
+
+template <typename F>
+auto measure(const char* name, F&& f) -> std::string {
+	std::string result {};
+	const std::size_t count0 = allocations;
+	const double t = msPerCall(3, [&] { result = f(); });
+	const double count = double(allocations - count0) / 3;
+	std::printf("%-14s %10.2f ms %12.0f allocations %8.1f MB/s\n",
+		name, t, count, result.size() / (t * 1000));
+	return result;
+}
+
+int main(int argc, char** argv) {
+	const std::size_t count = argc > 1 ? std::atol(argv[1]) : 20'000;
+	std::mt19937 rng {22};
+	std::vector<Element> elements {};
+	for (std::size_t i=0; i<count; i++) elements.push_back(randomElement(rng));
+	const Sketch sketch {elements};
+	FlatSketch raw {};
+	for (int i=0; i<20'000; i++) {
+		Atom::FlatStroke s {};
+		for (int j=rng()%100; j>0; j--) s.points.push_back({int(rng() % 1296), int(rng() % 1296)});
+		raw.strokes.push_back(s);
+	}
+
+	auto old = measure("operator<<", [&] {
+		std::ostringstream os;
+		Old::print(os, sketch);
+		return os.str();
+	});
+	auto stream = measure("writer, stream", [&] {
+		std::ostringstream os;
+		SketchFormat::print(os, sketch);
+		return os.str();
+	});
+	std::string reused {};
+	auto string = measure("writer, string", [&] {
+		reused.clear();
+		SketchFormat::print(reused, sketch);
+		return reused;
+	});
+	bool identical = old == stream && old == string;
+
+	auto oldRaw = measure("raw operator<<", [&] {
+		std::ostringstream os;
+		Old::printRaw(os, raw);
+		return os.str();
+	});
+	auto newRaw = measure("raw writer", [&] {
+		std::ostringstream os;
+		RawFormat::print(os, raw);
+		return os.str();
+	});
+	identical &= oldRaw == newRaw;
+
+	std::printf("%.1f MiB written, output %s\n",
+		old.size() / (1024.0 * 1024.0), identical ? "identical" : "DIFFERS");
+	return !identical;
+}
@@ -0,0 +1,72 @@
+#include "damage.hh"
+#include "renderer.hh"
+#include "util.hh"
+#include <algorithm>
+#include <iterator>
+
+void Damage::add(Rect r) {
+	if (isEmpty(r)) return;
+
+	// Absorb everything r touches, (which can make r grow
+	// into rects it missed the first time, so repeat).
+	for (bool merged = true; merged; /**/) {
+		merged = false;
+		for (auto it = rects.begin(); it != rects.end(); /**/) {
+			if (isEmpty(intersect(*it, r))) { ++it; continue; }
+			r = join(r, *it);
+			it = rects.erase(it);
+			merged = true;
+		}
+	}
+	rects.push_back(r);
+
+	if (rects.size() > MaxRects) {
+		Rect all = rects[0];
+		for (Rect q : rects) all = join(all, q);
+		rects = {all};
+	}
+}
+
+void Damage::addChanges(
+	std::span<const Atom::FlatStroke> before,
+	std::span<const Atom::FlatStroke> after
+) {
+	auto [b0, a0] = ranges::mismatch(before, after);
+	auto [b1, a1] = ranges::mismatch(
+		ranges::subrange(b0, before.end()) | views::reverse,
+		ranges::subrange(a0, after.end())  | views::reverse
+	);
+
+	for (const auto& s : ranges::subrange(b0, b1.base())) add(Renderer::bounds(s));
+	for (const auto& s : ranges::subrange(a0, a1.base())) add(Renderer::bounds(s));
+}
+
+void Damage::addChanges(
+	std::span<const SharedInstances> before,
+	std::span<const SharedInstances> after
+) {
+	auto [b0, a0] = ranges::mismatch(before, after);
+	auto [b1, a1] = ranges::mismatch(
+		ranges::subrange(b0, before.end()) | views::reverse,
+		ranges::subrange(a0, after.end())  | views::reverse
+	);
+
+	// Compare what's left stroke by stroke, since the same strokes
+	// can be split across elements differently. (A committed stroke
+	// is its own element in the frame, but part of a Brush after.)
+	auto strokes = [](auto&& elements) {
+		FlatStrokeAtoms result {};
+		for (const SharedInstances& e : elements) {
+			ranges::move(e->materialize(), std::back_inserter(result));
+		}
+		return result;
+	};
+	addChanges(
+		strokes(ranges::subrange(b0, b1.base())),
+		strokes(ranges::subrange(a0, a1.base()))
+	);
+}
+
+auto Damage::regions() const -> std::span<const Rect> { return rects; }
+bool Damage::empty() const { return rects.empty(); }
+void Damage::clear() { rects.clear(); }
@@ -0,0 +1,33 @@
+#pragma once
+#include "types.hh"
+#include "graphics.hh"
+#include <span>
+#include <vector>
+
+// Regions of the canvas which need to be repainted. Overlapping
+// regions are merged, and past a handful of them it gives up and
+// keeps just their bounding box (one big rect beats many tiny ones).
+class Damage {
+	std::vector<Rect> rects;
+	static constexpr std::size_t MaxRects = 16;
+
+public:
+	void add(Rect);
+	// Damages wherever the two lists of strokes differ, ignoring the
+	// strokes they start and end with in common. (So drawing a new
+	// stroke, or an undo/redo of one, only damages that stroke.)
+	void addChanges(
+		std::span<const Atom::FlatStroke> before,
+		std::span<const Atom::FlatStroke> after
+	);
+	// Same, but elements they share are skipped by pointer,
+	// so only the ones in between ever get materialized.
+	void addChanges(
+		std::span<const SharedInstances> before,
+		std::span<const SharedInstances> after
+	);
+
+	auto regions() const -> std::span<const Rect>;
+	bool empty() const;
+	void clear();
+};
@@ -0,0 +1,76 @@
+#include "frameCache.hh"
+#include "util.hh"
+#include <algorithm>
+
+FrameCache::FrameCache(std::size_t budget)
+: budget{budget} {}
+
+void FrameCache::store(std::size_t state, std::span<const uint32_t> pixels) {
+	Frame frame {{}, pixels.size(), ++generation};
+	for (std::size_t i=0; i<pixels.size(); /**/) {
+		const uint32_t pixel = pixels[i];
+		const std::size_t start = i;
+		while (i < pixels.size() && pixels[i] == pixel && i-start < UINT32_MAX) i++;
+		frame.runs.push_back(i - start);
+		frame.runs.push_back(pixel);
+	}
+	frame.runs.shrink_to_fit();
+
+	const std::size_t size = frame.runs.size() * sizeof(uint32_t);
+	if (auto it = frames.find(state); it != frames.end()) {
+		bytes -= it->second.runs.size() * sizeof(uint32_t);
+		frames.erase(it);
+	}
+	// Not worth pushing everything else out for.
+	if (size > budget) return;
+
+	frames.emplace(state, std::move(frame));
+	bytes += size;
+	evict();
+}
+
+bool FrameCache::restore(std::size_t state, std::span<uint32_t> pixels) {
+	auto it = frames.find(state);
+	if (it == frames.end() || it->second.pixels != pixels.size()) {
+		counters.misses++;
+		return false;
+	}
+
+	Frame& frame = it->second;
+	frame.lastUsed = ++generation;
+	uint32_t* out = pixels.data();
+	for (std::size_t i=0; i<frame.runs.size(); i+=2) {
+		out = std::fill_n(out, frame.runs[i], frame.runs[i+1]);
+	}
+	counters.hits++;
+	return true;
+}
+
+void FrameCache::evict() {
+	while (bytes > budget) {
+		auto oldest = ranges::min_element(frames, {},
+			[](const auto& entry) { return entry.second.lastUsed; }
+		);
+		bytes -= oldest->second.runs.size() * sizeof(uint32_t);
+		frames.erase(oldest);
+	}
+}
+
+void FrameCache::setBudget(std::size_t b) {
+	budget = b;
+	evict();
+}
+
+void FrameCache::clear() {
+	frames.clear();
+	bytes = 0;
+}
+
+auto FrameCache::stats() const -> Stats {
+	Stats result = counters;
+	result.frames = frames.size();
+	result.bytes = bytes;
+	return result;
+}
+
+void FrameCache::resetStats() { counters = {}; }
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// Rendered frames of recently seen History states, (by History::id),
+// so stepping through undo/redo copies a frame back instead of drawing
+// it again. Frames are run-length encoded, since drawings are mostly
+// blank paper, and the least recently used go once the budget's spent.
+class FrameCache {
+public:
+	struct Stats { std::size_t hits=0, misses=0, frames=0, bytes=0; };
+
+private:
+	struct Frame {
+		std::vector<uint32_t> runs; // (length, pixel) pairs.
+		std::size_t pixels;
+		std::size_t lastUsed;
+	};
+	std::unordered_map<std::size_t, Frame> frames;
+	std::size_t budget;
+	std::size_t bytes = 0;
+	std::size_t generation = 0;
+	Stats counters {};
+
+	void evict();
+
+public:
+	FrameCache(std::size_t budget = 32 << 20);
+
+	void store(std::size_t state, std::span<const uint32_t> pixels);
+	// Writes the state's frame into pixels, if there is one.
+	bool restore(std::size_t state, std::span<uint32_t> pixels);
+
+	void setBudget(std::size_t);
+	void clear();
+	auto stats() const -> Stats;
+	void resetStats();
+};
@@ -1,10 +1,37 @@
 #include "graphics.hh"
+#include <limits>
+
+#if defined(__AVX2__)
+#	include <immintrin.h>
+#elif defined(__SSE2__)
+#	include <emmintrin.h>
+#elif defined(__wasm_simd128__)
+#	include <wasm_simd128.h>
+#endif
 
 Real dot (Vec2 a, Vec2 b) { return a.x*b.x + a.y*b.y; }
 Real dot2(Vec2 a) /*   */ { return dot(a,a); }
 Real len (Vec2 a) /*   */ { return sqrt(dot2(a)); }
 Vec2 norm(Vec2 a) /*   */ { return {a.x/len(a), a.y/len(a)}; }
 
+bool isEmpty(Rect a) { return a.x0 >= a.x1 || a.y0 >= a.y1; }
+
+Rect intersect(Rect a, Rect b) {
+	return {
+		std::max(a.x0, b.x0), std::max(a.y0, b.y0),
+		std::min(a.x1, b.x1), std::min(a.y1, b.y1),
+	};
+}
+
+Rect join(Rect a, Rect b) {
+	if (isEmpty(a)) return b;
+	if (isEmpty(b)) return a;
+	return {
+		std::min(a.x0, b.x0), std::min(a.y0, b.y0),
+		std::max(a.x1, b.x1), std::max(a.y1, b.y1),
+	};
+}
+
 // https://iquilezles.org/articles/distfunctions2d
 
 Real SDFline(Vec2 p, Vec2 a, Vec2 b) {
@@ -15,4 +42,162 @@ Real SDFline(Vec2 p, Vec2 a, Vec2 b) {
 
 	Real h = clamp(dot(c,d)/dot2(d), 0, 1);
 	return len(Vec2 {c.x - d.x*h, c.y - d.y*h});
-}
\ No newline at end of file
+}
+
+// A capsule is the union of its two end discs and the rectangle
+// between them. Each of those meets a row in an interval, and the
+// capsule is convex, so their hull is the exact covered span.
+Interval SDFlineRow(Real y, Vec2 a, Vec2 b, Real r) {
+	constexpr Real Inf = std::numeric_limits<Real>::infinity();
+	Interval result {+Inf, -Inf};
+	auto join = [&](Real lo, Real hi) {
+		if (lo > hi) return;
+		result = {min(result.lo, lo), max(result.hi, hi)};
+	};
+
+	auto disc = [&](Vec2 o) {
+		Real dy = y - o.y;
+		if (dy*dy > r*r) return;
+		Real half = sqrt(r*r - dy*dy);
+		join(o.x - half, o.x + half);
+	};
+
+	// Solves lo <= k*x + c <= hi for x.
+	auto solve = [](Real k, Real c, Real lo, Real hi) -> Interval {
+		if (k == 0) return (lo <= c && c <= hi)
+			? Interval {-Inf, +Inf}
+			: Interval {+Inf, -Inf};
+		Real x0 = (lo-c)/k, x1 = (hi-c)/k;
+		return {min(x0, x1), max(x0, x1)};
+	};
+
+	disc(a);
+	disc(b);
+
+	Vec2 d {b.x-a.x, b.y-a.y};
+	if (dot2(d) == 0) return result; // Point case
+
+	// Projection onto the segment within [0,1], and the
+	// perpendicular distance within r (scaled by |d|).
+	const Real dy = y - a.y;
+	Interval along  = solve(d.x, d.y*dy, 0, dot2(d));
+	Interval across = solve(-d.y, d.x*dy, -r*len(d), r*len(d));
+	join(a.x + max(along.lo, across.lo), a.x + min(along.hi, across.hi));
+
+	return result;
+}
+
+/* ~~ Coverage Kernel ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+LineSDF::LineSDF(Vec2 a, Vec2 b)
+: a{a}, d{b.x-a.x, b.y-a.y}
+, invDot2d{dot2(d) == 0 ? 0 : 1/dot2(d)} {}
+
+void SDFlineCoverage(
+	uint8_t* out, std::size_t n,
+	Real x, Real y, const LineSDF& l
+) {
+	const Real cy = y - l.a.y;
+	std::size_t i = 0;
+
+#if defined(__AVX2__)
+	const __m256d dx = _mm256_set1_pd(l.d.x), dy = _mm256_set1_pd(l.d.y);
+	const __m256d inv = _mm256_set1_pd(l.invDot2d);
+	const __m256d vcy = _mm256_set1_pd(cy), dcy = _mm256_mul_pd(vcy, dy);
+	const __m256d zero = _mm256_set1_pd(0), one = _mm256_set1_pd(1);
+	const __m256d full = _mm256_set1_pd(255);
+
+	auto lanes = [&](__m256d cx) {
+		__m256d h = _mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(cx, dx), dcy), inv);
+		h = _mm256_max_pd(zero, _mm256_min_pd(one, h));
+		__m256d ex = _mm256_sub_pd(cx , _mm256_mul_pd(dx, h));
+		__m256d ey = _mm256_sub_pd(vcy, _mm256_mul_pd(dy, h));
+		__m256d dist = _mm256_sqrt_pd(
+			_mm256_add_pd(_mm256_mul_pd(ex, ex), _mm256_mul_pd(ey, ey))
+		);
+		__m256d c = _mm256_max_pd(zero, _mm256_min_pd(one, _mm256_sub_pd(dist, one)));
+		return _mm256_cvttpd_epi32(_mm256_mul_pd(full, c));
+	};
+
+	__m256d cx = _mm256_add_pd(
+		_mm256_set1_pd(x - l.a.x),
+		_mm256_set_pd(3, 2, 1, 0)
+	);
+	for (; i<n; i+=8) {
+		__m128i lo = lanes(cx);
+		__m128i hi = lanes(_mm256_add_pd(cx, _mm256_set1_pd(4)));
+		__m128i c16 = _mm_packus_epi32(lo, hi);
+		_mm_storel_epi64((__m128i*)(out+i), _mm_packus_epi16(c16, c16));
+		cx = _mm256_add_pd(cx, _mm256_set1_pd(8));
+	}
+
+#elif defined(__SSE2__)
+	const __m128d dx = _mm_set1_pd(l.d.x), dy = _mm_set1_pd(l.d.y);
+	const __m128d inv = _mm_set1_pd(l.invDot2d);
+	const __m128d vcy = _mm_set1_pd(cy), dcy = _mm_mul_pd(vcy, dy);
+	const __m128d zero = _mm_set1_pd(0), one = _mm_set1_pd(1);
+	const __m128d full = _mm_set1_pd(255);
+
+	auto lanes = [&](__m128d cx) {
+		__m128d h = _mm_mul_pd(_mm_add_pd(_mm_mul_pd(cx, dx), dcy), inv);
+		h = _mm_max_pd(zero, _mm_min_pd(one, h));
+		__m128d ex = _mm_sub_pd(cx , _mm_mul_pd(dx, h));
+		__m128d ey = _mm_sub_pd(vcy, _mm_mul_pd(dy, h));
+		__m128d dist = _mm_sqrt_pd(
+			_mm_add_pd(_mm_mul_pd(ex, ex), _mm_mul_pd(ey, ey))
+		);
+		__m128d c = _mm_max_pd(zero, _mm_min_pd(one, _mm_sub_pd(dist, one)));
+		return _mm_cvttpd_epi32(_mm_mul_pd(full, c));
+	};
+
+	__m128d cx = _mm_add_pd(_mm_set1_pd(x - l.a.x), _mm_set_pd(1, 0));
+	for (; i<n; i+=4) {
+		__m128i lo = lanes(cx);
+		__m128i hi = lanes(_mm_add_pd(cx, _mm_set1_pd(2)));
+		__m128i c32 = _mm_unpacklo_epi64(lo, hi);
+		__m128i c16 = _mm_packs_epi32(c32, c32);
+		*(int32_t*)(out+i) = _mm_cvtsi128_si32(_mm_packus_epi16(c16, c16));
+		cx = _mm_add_pd(cx, _mm_set1_pd(4));
+	}
+
+#elif defined(__wasm_simd128__)
+	const v128_t dx = wasm_f64x2_splat(l.d.x), dy = wasm_f64x2_splat(l.d.y);
+	const v128_t inv = wasm_f64x2_splat(l.invDot2d);
+	const v128_t vcy = wasm_f64x2_splat(cy), dcy = wasm_f64x2_mul(vcy, dy);
+	const v128_t zero = wasm_f64x2_splat(0), one = wasm_f64x2_splat(1);
+	const v128_t full = wasm_f64x2_splat(255);
+
+	auto lanes = [&](v128_t cx) {
+		v128_t h = wasm_f64x2_mul(wasm_f64x2_add(wasm_f64x2_mul(cx, dx), dcy), inv);
+		h = wasm_f64x2_max(zero, wasm_f64x2_min(one, h));
+		v128_t ex = wasm_f64x2_sub(cx , wasm_f64x2_mul(dx, h));
+		v128_t ey = wasm_f64x2_sub(vcy, wasm_f64x2_mul(dy, h));
+		v128_t dist = wasm_f64x2_sqrt(
+			wasm_f64x2_add(wasm_f64x2_mul(ex, ex), wasm_f64x2_mul(ey, ey))
+		);
+		v128_t c = wasm_f64x2_max(zero, wasm_f64x2_min(one, wasm_f64x2_sub(dist, one)));
+		return wasm_i32x4_trunc_sat_f64x2_zero(wasm_f64x2_mul(full, c));
+	};
+
+	v128_t cx = wasm_f64x2_add(
+		wasm_f64x2_splat(x - l.a.x),
+		wasm_f64x2_make(0, 1)
+	);
+	for (; i<n; i+=4) {
+		v128_t lo = lanes(cx);
+		v128_t hi = lanes(wasm_f64x2_add(cx, wasm_f64x2_splat(2)));
+		v128_t c32 = wasm_i32x4_shuffle(lo, hi, 0, 1, 4, 5);
+		v128_t c16 = wasm_i16x8_narrow_i32x4(c32, c32);
+		wasm_v128_store32_lane(out+i, wasm_u8x16_narrow_i16x8(c16, c16), 0);
+		cx = wasm_f64x2_add(cx, wasm_f64x2_splat(4));
+	}
+#endif
+
+	// Scalar fallback.
+	for (; i<n; i++) {
+		Vec2 c {x + i - l.a.x, cy};
+		Real h = clamp((c.x*l.d.x + c.y*l.d.y) * l.invDot2d, 0, 1);
+		Real dist = len(Vec2 {c.x - l.d.x*h, c.y - l.d.y*h});
+		out[i] = 255*clamp(dist - 1, 0, 1);
+	}
+}
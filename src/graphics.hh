@@ -1,12 +1,51 @@
 #pragma once
 #include "math.hh"
+#include <cstdint>
+#include <cstddef>
 
 struct Col3 { uint8_t r, g, b; };
 struct Vec2 { Real x, y; };
+struct Interval { Real lo, hi; };
+struct Rect { // Covers [x0,x1) x [y0,y1)
+	int x0, y0, x1, y1;
+	bool operator==(const Rect&) const = default;
+};
 
 Real dot (Vec2 a, Vec2 b);
 Real dot2(Vec2 a);
 Real len (Vec2 a);
 Vec2 norm(Vec2 a);
 
-Real SDFline(Vec2 p, Vec2 a, Vec2 b);
\ No newline at end of file
+bool isEmpty  (Rect a);
+Rect intersect(Rect a, Rect b);
+Rect join     (Rect a, Rect b); // Bounding box of both
+
+Real SDFline(Vec2 p, Vec2 a, Vec2 b);
+// The x values along row y where SDFline(p,a,b) <= r,
+// (lo > hi when the row misses the capsule entirely).
+Interval SDFlineRow(Real y, Vec2 a, Vec2 b, Real r);
+
+// SDFline with the per-segment terms hoisted out, for
+// evaluating whole rows of pixels at once.
+struct LineSDF {
+	Vec2 a, d;
+	Real invDot2d; // 0 in the point case, so h always clamps to 0.
+	LineSDF(Vec2 a, Vec2 b);
+};
+
+// Writes 255*clamp(SDFline(p,a,b) - 1, 0, 1) for the n pixel
+// centers p = (x+i, y). Uses AVX2, SSE2 or wasm simd128 when
+// the build enables them, and plain scalar code otherwise.
+// Whole blocks are always written, so out needs room for n
+// rounded up to SDFlineCoverageBlock. (Every pixel then goes
+// through the same lanes, and comes out the same no matter
+// where its row was split up.)
+void SDFlineCoverage(uint8_t* out, std::size_t n, Real x, Real y, const LineSDF&);
+
+#if defined(__AVX2__)
+	constexpr std::size_t SDFlineCoverageBlock = 8;
+#elif defined(__SSE2__) || defined(__wasm_simd128__)
+	constexpr std::size_t SDFlineCoverageBlock = 4;
+#else
+	constexpr std::size_t SDFlineCoverageBlock = 1;
+#endif
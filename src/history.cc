@@ -0,0 +1,29 @@
+#include "history.hh"
+
+auto History::view() const -> const Sketch& { return states[head].sketch; }
+auto History::id() const -> std::size_t { return states[head].id; }
+void History::look_back   () { head -= (head > 0); }
+void History::look_forward() { head += (head < states.size()-1); }
+
+void History::push(Sketch s) {
+	states.resize(++head);
+	states.push_back({std::move(s), nextId++});
+}
+
+void History::commitStroke(const Atom::Stroke& s) {
+	Sketch next = view();
+	auto& elements = next.elements;
+
+	if (elements.empty()
+	||  !std::holds_alternative<Brush>(elements.back())) {
+		elements.push_back(Brush {});
+	}
+
+	// Only the path to the last Brush gets copied, and its
+	// strokes go on the end of the columns it already shares.
+	std::get<Brush>(elements.editBack()).atoms.push_back(s);
+	push(std::move(next));
+	states.back().stroke = true;
+}
+
+auto History::size() const -> std::size_t { return states.size(); }
@@ -0,0 +1,29 @@
+#pragma once
+#include "types.hh"
+#include <vector>
+
+// Every state the sketch has been in, for undo/redo. States are
+// Sketches, which share whatever elements (and stroke columns) they
+// have in common, so each state only costs what changed in it.
+class History {
+	// (Made by commitStroke, so a checkpoint only has to write the
+	// stroke, not the whole sketch, see Journal.)
+	struct State { Sketch sketch; std::size_t id; bool stroke = false; };
+	std::vector<State> states {{Sketch {}, 0}};
+	std::size_t head = 0;
+	std::size_t nextId = 1;
+	friend class Journal;
+
+public:
+	auto view() const -> const Sketch&;
+	// Names the state being viewed. No two states ever get the same
+	// id, even when an undo and a new stroke put one where another was.
+	auto id() const -> std::size_t;
+	void look_back   ();
+	void look_forward();
+	void push(Sketch);
+	// Pushes the current state with s added to its last Brush,
+	// (or to a new one, if the sketch doesn't end in a Brush).
+	void commitStroke(const Atom::Stroke& s);
+	auto size() const -> std::size_t;
+};
@@ -0,0 +1,171 @@
+#include "journal.hh"
+#include "parsers.hh"
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <optional>
+
+/* ~~ Sinks ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void MemorySink::append(std::string_view s) { contents += s; }
+void MemorySink::replace(std::string_view s) { contents = s; }
+
+FileSink::FileSink(std::string path)
+: path{std::move(path)}, file{this->path, std::ios::binary | std::ios::app} {}
+
+void FileSink::append(std::string_view s) {
+	file.write(s.data(), s.size());
+	file.flush();
+}
+
+void FileSink::replace(std::string_view s) {
+	const std::string temp = path + ".tmp";
+	{
+		std::ofstream out {temp, std::ios::binary | std::ios::trunc};
+		out.write(s.data(), s.size());
+	}
+	file.close();
+	std::rename(temp.c_str(), path.c_str());
+	file.open(path, std::ios::binary | std::ios::app);
+}
+
+/* ~~ Journal ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+namespace
+{
+	auto strokeRecord(const Atom::Stroke& s) -> std::string {
+		StrokeAtoms atoms {};
+		atoms.push_back(s);
+		std::string record = "s ";
+		TextWriter {record}.write(Element {Brush {atoms, {}}});
+		record += ";\n";
+		return record;
+	}
+
+	// A record holding a whole sketch: its header, how long the .hsc
+	// is, then the .hsc on the lines after.
+	void appendWhole(std::string& out, std::string_view header, const Sketch& sketch) {
+		std::string text {};
+		SketchFormat::print(text, sketch);
+		out += header;
+		out += " " + std::to_string(text.size()) + "\n";
+		out += text;
+		out += "\n";
+	}
+
+	// The numbers after a record's letter, (exactly N, and nothing else).
+	template <std::size_t N>
+	auto numbers(std::string_view line) -> std::optional<std::array<std::size_t, N>> {
+		std::array<std::size_t, N> result {};
+		const char* p = line.data() + 1;
+		const char* end = line.data() + line.size();
+		for (std::size_t& n : result) {
+			if (p == end || *p != ' ') return std::nullopt;
+			auto [next, err] = std::from_chars(p+1, end, n);
+			if (err != std::errc {}) return std::nullopt;
+			p = next;
+		}
+		if (p != end) return std::nullopt;
+		return result;
+	}
+}
+
+Journal::Journal(JournalSink& sink)
+: sink{sink} {}
+
+void Journal::commitStroke(const Atom::Stroke& s) {
+	sink.append(strokeRecord(s));
+	sinceCheckpoint++;
+}
+
+void Journal::undo() { sink.append("u\n"), sinceCheckpoint++; }
+void Journal::redo() { sink.append("r\n"), sinceCheckpoint++; }
+
+void Journal::checkpoint(const History& history) {
+	const auto& states = history.states;
+	const std::size_t head = history.head;
+	// The states either side of head that strokes lead to and from.
+	std::size_t first = head, last = head;
+	while (first > 0 && head - first < CheckpointKeeps && states[first].stroke) first--;
+	while (last+1 < states.size() && last - head < CheckpointKeeps && states[last+1].stroke) last++;
+
+	std::string out {};
+	appendWhole(out, "c " + std::to_string(states[first].id), states[first].sketch);
+
+	// Ids only need writing where they skip, (past states undone and
+	// then pushed over).
+	std::size_t nextId = states[first].id + 1;
+	for (std::size_t i=first+1; i<=last; i++) {
+		const auto& state = states[i];
+		if (state.id != nextId) out += "n " + std::to_string(state.id) + "\n";
+		nextId = state.id + 1;
+		// (The stroke that made it is the last of its last Brush.)
+		const auto& atoms = std::get<Brush>(state.sketch.elements.back()).atoms;
+		out += strokeRecord(Atom::Stroke {atoms[atoms.size()-1]});
+	}
+	if (history.nextId != nextId) out += "n " + std::to_string(history.nextId) + "\n";
+	for (std::size_t i=head; i<last; i++) out += "u\n";
+
+	sink.replace(out);
+	sinceCheckpoint = 0;
+}
+
+bool Journal::wantsCheckpoint() const {
+	return sinceCheckpoint >= CheckpointEvery;
+}
+
+auto Journal::replay(std::string_view text) -> History {
+	History history {};
+
+	std::size_t i = 0;
+	// The n bytes of .hsc on the lines after a record, (and the
+	// newline they end with).
+	auto whole = [&](std::size_t n) -> std::optional<Sketch> {
+		if (n >= text.size() - i || text[i+n] != '\n') return std::nullopt;
+		auto sketch = SketchFormat::parse(text.substr(i, n));
+		if (!sketch) return std::nullopt;
+		i += n + 1;
+		return std::move(*sketch);
+	};
+
+	while (i < text.size()) {
+		const std::size_t eol = text.find('\n', i);
+		if (eol == text.npos) break;
+		const std::string_view line = text.substr(i, eol-i);
+		i = eol + 1;
+
+		if (line == "u") { history.look_back(); continue; }
+		if (line == "r") { history.look_forward(); continue; }
+
+		if (line.starts_with("s ")) {
+			auto sketch = SketchFormat::parse(line.substr(2));
+			if (!sketch || sketch->elements.size() != 1) break;
+			auto* brush = std::get_if<Brush>(&sketch->elements[0]);
+			if (!brush || brush->atoms.size() != 1) break;
+			history.commitStroke(Atom::Stroke {brush->atoms[0]});
+			continue;
+		}
+
+		if (line.starts_with("c ")) {
+			const auto n = numbers<2>(line);
+			auto sketch = n ? whole((*n)[1]) : std::nullopt;
+			if (!sketch) break;
+			const auto [id, _] = *n;
+			history = History {};
+			history.states = {{std::move(*sketch), id}};
+			history.nextId = id + 1;
+			continue;
+		}
+
+		if (line.starts_with("n ")) {
+			const auto n = numbers<1>(line);
+			if (!n) break;
+			history.nextId = (*n)[0];
+			continue;
+		}
+
+		break;
+	}
+
+	return history;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "history.hh"
+#include <fstream>
+#include <string>
+#include <string_view>
+
+// Somewhere for journal records to go.
+class JournalSink {
+public:
+	virtual ~JournalSink() = default;
+	virtual void append(std::string_view) = 0;
+	// Swaps everything written so far for the given text, in one go.
+	virtual void replace(std::string_view) = 0;
+};
+
+class MemorySink : public JournalSink {
+public:
+	std::string contents;
+	void append(std::string_view) override;
+	void replace(std::string_view) override;
+};
+
+// Flushes after every record, and replaces the file by writing
+// a new one beside it, then renaming it over the old one.
+class FileSink : public JournalSink {
+	std::string path;
+	std::ofstream file;
+public:
+	FileSink(std::string path);
+	void append(std::string_view) override;
+	void replace(std::string_view) override;
+};
+
+// An append-only log of what happens to a History, one small record
+// per stroke, undo and redo, so saving costs as much as the change
+// instead of the whole document. Every so often a checkpoint replaces
+// the records before it with the states around the one being viewed:
+// the oldest (in .hsc), the strokes that made the rest, then undos back
+// to the viewed one, so undo and redo survive it too.
+//
+//     s Brush [ 03 0a0b0c'1z ];    a committed stroke
+//     u                            undo
+//     r                            redo
+//     c 0 1234                     checkpoint, a History of one state
+//                                  with id 0, then 1234 bytes of .hsc
+//     n 17                         the id the next state will get
+//
+class Journal {
+	JournalSink& sink;
+	std::size_t sinceCheckpoint = 0;
+
+public:
+	static constexpr std::size_t CheckpointEvery = 256;
+	// How many undos and redos a checkpoint keeps, at most. It stops
+	// early at any state that wasn't a stroke, (one pushed whole), so
+	// it writes one sketch and at most twice this many strokes, and
+	// that's all replaying it costs, however long the session's been.
+	static constexpr std::size_t CheckpointKeeps = 1024;
+
+	Journal(JournalSink&);
+	void commitStroke(const Atom::Stroke&);
+	void undo();
+	void redo();
+	void checkpoint(const History&);
+	bool wantsCheckpoint() const;
+
+	// Rebuilds the History a journal describes, every state with the
+	// same id it had, and viewing the same one. It stops at the first
+	// record that didn't make it out whole, keeping what came before.
+	static auto replay(std::string_view) -> History;
+};
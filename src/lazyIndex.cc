@@ -0,0 +1,235 @@
+#include "lazyIndex.hh"
+#include <algorithm>
+#include <array>
+
+/* ~~ Indexing ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+auto SketchFormat::index(std::string_view str)
+-> Expected<Index> {
+	Index result {};
+	result.text = str;
+	const auto starts = elementStarts(str);
+	std::vector<Token> tokens {};
+
+	for (std::size_t i=0; i<starts.size(); i++) {
+		const std::size_t offset = starts[i].offset;
+		const SourcePos pos = starts[i].pos;
+		const std::size_t end = i+1 < starts.size() ? starts[i+1].offset : str.size();
+		const TokenizerState state = offset == 0 ? LineStart : Space;
+
+		// Tokenize the type and '[', skip the atoms, (just counting lines),
+		// then tokenize the ']' and modifiers up to the delimiter. Anything
+		// not fitting that gets parsed whole, right now.
+		auto lazy = [&] -> std::optional<Index::Entry> {
+			const auto payload = Index::payloadOf(str, offset, end);
+			if (!payload) return std::nullopt;
+			const auto [open, close] = *payload;
+
+			tokens.clear();
+			SourcePos at = pos;
+			auto head = tokenize(str.substr(offset, open+1 - offset), tokens, at, state);
+			if (!head || tokens.size() != 2) return std::nullopt;
+			const std::size_t type =
+			  tokens[0] == Token {"Brush" } ? 0
+			: tokens[0] == Token {"Pencil"} ? 1
+			: tokens[0] == Token {"Data"  } ? 2
+			: tokens[0] == Token {"Raw"   } ? 2
+			: /* default:                */   std::variant_npos;
+			if (type == std::variant_npos) return std::nullopt;
+
+			const auto atoms = str.substr(open+1, close - (open+1));
+			if (const auto newline = atoms.rfind('\n'); newline != atoms.npos) {
+				at.row += std::ranges::count(atoms, '\n');
+				at.col = atoms.size()-1 - newline;
+			}
+			else at.col += atoms.size();
+
+			tokens.clear();
+			auto tail = tokenize(str.substr(close, end - close), tokens, at, Space);
+			if (!tail || *tail == std::string_view::npos) return std::nullopt;
+			auto modifiers = modsStrokeParse(TokenSpan {tokens}.subspan(1, tokens.size()-2));
+			if (!modifiers) return std::nullopt;
+
+			return Index::Entry {offset, close + *tail - offset, pos, type, std::move(*modifiers)};
+		} ();
+
+		if (lazy) {
+			result.entries.push_back(std::move(*lazy));
+			continue;
+		}
+
+		Reader reader = offset == 0 ? Reader {str} : Reader {str.substr(offset), pos};
+		auto element = reader.next();
+		if (!element) return Unexpected(element.error());
+		if (!*element) break; // (A lone ';'.)
+		Index::Entry entry {offset, end - offset, pos, (*element)->index(), {}};
+		entry.element = std::make_shared<const Element>(std::move(**element));
+		entry.box = strokeBounds(*entry.element);
+		entry.pinned = true;
+		result.entries.push_back(std::move(entry));
+	}
+	return result;
+}
+
+auto SketchFormat::index(std::shared_ptr<const MappedFile> file)
+-> Expected<Index> {
+	auto result = index(file->view());
+	if (result) result->source = std::move(file);
+	return result;
+}
+
+auto SketchFormat::Index::payloadOf(
+	std::string_view str, std::size_t offset, std::size_t end
+) -> std::optional<std::pair<std::size_t, std::size_t>> {
+	// Same as elementStarts(), only stopping on the chars that matter,
+	// (and giving up on any string, which needs the tokenizer).
+	constexpr auto special = [] {
+		std::array<bool, 256> table {};
+		for (char c : "\n\r%[]();,"sv) table[uint8_t(c)] = true;
+		return table;
+	} ();
+
+	std::optional<std::size_t> open {};
+	bool comment = false;
+	for (std::size_t i=offset; i<end; i++) {
+		const char c = str[i];
+		if (!special[uint8_t(c)]) continue;
+		if (comment) {
+			if (isNewline(c)) comment = false;
+			continue;
+		}
+		if (c == '%' && (i == 0 || isNewline(str[i-1]))) comment = true;
+		if (c == '[') {
+			if (open) return std::nullopt;
+			open = i;
+		}
+		if (c == ']') {
+			if (!open) return std::nullopt;
+			return std::pair {*open, i};
+		}
+		if (Util::isAny(c, "(),;")) return std::nullopt;
+	}
+	return std::nullopt;
+}
+
+/* ~~ Decoding ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+namespace
+{
+	// Roughly what an element's atoms take up on the heap.
+	auto approxBytes(const Element& variant) -> std::size_t {
+		return sizeof(Element) + std::visit([]<typename T>(const T& elem) -> std::size_t {
+			std::size_t points = 0;
+			if constexpr (HoldsStrokeAtoms<T>) {
+				for (const auto& stroke : elem.atoms) points += stroke.size();
+				return points*3*sizeof(int16_t) + elem.atoms.size()*(sizeof(uint32_t) + sizeof(uint16_t));
+			}
+			else if constexpr (HoldsFlatStrokeAtoms<T>) {
+				for (const auto& stroke : elem.atoms) points += stroke.points.size();
+				return points*sizeof(Atom::FlatStroke::Point) + elem.atoms.size()*sizeof(Atom::FlatStroke);
+			}
+			else return elem.atoms.text.size();
+		}, variant);
+	}
+}
+
+auto SketchFormat::Index::size() const -> std::size_t { return entries.size(); }
+auto SketchFormat::Index::type(std::size_t i) const -> std::size_t { return entries[i].type; }
+auto SketchFormat::Index::bounds(std::size_t i) const
+-> std::optional<std::pair<Point,Point>> { return entries[i].box; }
+bool SketchFormat::Index::decoded(std::size_t i) const { return bool(entries[i].element); }
+
+auto SketchFormat::Index::range(std::size_t i) const
+-> std::pair<std::size_t, std::size_t> {
+	return {entries[i].offset, entries[i].length};
+}
+
+auto SketchFormat::Index::element(std::size_t i)
+-> Expected<std::shared_ptr<const Element>> {
+	Entry& entry = entries[i];
+	if (entry.element) {
+		if (!entry.pinned) recent.splice(recent.begin(), recent, entry.recent);
+		return entry.element;
+	}
+
+	// Indexing already found its delimiter, so this is the element.
+	const auto [offset, length] = range(i);
+	Reader reader = offset == 0 ? Reader {text} : Reader {text.substr(offset), entry.pos};
+	auto element = reader.next();
+	if (!element) return Unexpected(element.error());
+
+	entry.element = std::make_shared<const Element>(std::move(**element));
+	entry.box = strokeBounds(*entry.element);
+	entry.bytes = approxBytes(*entry.element);
+	entry.recent = recent.insert(recent.begin(), i);
+	bytes += entry.bytes;
+	counters.decodes++;
+
+	auto result = entry.element;
+	evict();
+	return result;
+}
+
+auto SketchFormat::Index::sketch()
+-> Expected<Sketch> {
+	Sketch result {};
+	for (std::size_t i=0; i<entries.size(); i++) {
+		auto touched = element(i);
+		if (!touched) return Unexpected(touched.error());
+		result.elements.push_back(**touched);
+	}
+	result.source = source;
+	return result;
+}
+
+auto SketchFormat::Index::visit(StrokeVisitor& visitor)
+-> std::optional<ParseError> {
+	std::optional<ParseError> failed {};
+	for (std::size_t i=0; i<entries.size(); i++) {
+		const Entry& entry = entries[i];
+		if (entry.type == 3) continue; // (Markers have no strokes.)
+		if (!entry.element && entry.box
+		&&  !wantsAny(visitor, *entry.box, entry.modifiers)) continue;
+
+		auto touched = element(i);
+		if (touched) visitElement(**touched, visitor);
+		else if (!failed) failed = touched.error();
+	}
+	return failed;
+}
+
+/* ~~ Eviction ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void SketchFormat::Index::evict() {
+	// The newest always stays, however big it is.
+	while (bytes > budget && recent.size() > 1) {
+		Entry& oldest = entries[recent.back()];
+		recent.pop_back();
+		bytes -= std::exchange(oldest.bytes, 0);
+		oldest.element.reset();
+		counters.evictions++;
+	}
+}
+
+void SketchFormat::Index::setBudget(std::size_t b) {
+	budget = b;
+	evict();
+}
+
+void SketchFormat::Index::clear() {
+	for (std::size_t i : recent) {
+		entries[i].element.reset();
+		entries[i].bytes = 0;
+	}
+	recent.clear();
+	bytes = 0;
+}
+
+auto SketchFormat::Index::stats() const -> Stats {
+	Stats result = counters;
+	result.decoded = recent.size();
+	result.bytes = bytes;
+	return result;
+}
+
+void SketchFormat::Index::resetStats() { counters = {}; }
@@ -0,0 +1,79 @@
+#pragma once
+#include "parsers.hh"
+#include "types.hh"
+#include <list>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// A sketch opened without decoding its atoms: just each element's byte
+// range, type and modifiers, (found from a quick scan, plus tokenizing
+// what's either side of the '[ ... ]'). An element's atoms are decoded
+// the first time it's touched, then kept until the cache goes over its
+// budget, when the least recently used are dropped, (to be decoded again
+// from the text if they're needed again). Elements with nothing worth
+// deferring, (Markers, or anything unusual), are decoded up front and
+// never dropped. Not thread-safe, since reading an element can change
+// the cache.
+class SketchFormat::Index {
+public:
+	using Point = Atom::FlatStroke::Point;
+	struct Stats { std::size_t decodes=0, evictions=0, decoded=0, bytes=0; };
+
+private:
+	friend class SketchFormat;
+
+	struct Entry {
+		std::size_t offset, length; // In text, (up to its ',' or ';').
+		SourcePos pos;              // Where the element starts.
+		std::size_t type;           // Index into Element's alternatives.
+		StrokeModifiers modifiers;  // (Marker ones stay in the element.)
+		// Box of its points before modifiers, known once it's decoded,
+		// (and kept after it's dropped, to skip it when it's not wanted).
+		std::optional<std::pair<Point,Point>> box {};
+
+		std::shared_ptr<const Element> element {};
+		bool pinned = false;
+		std::size_t bytes = 0;
+		std::list<std::size_t>::iterator recent {};
+	};
+
+	std::string_view text {};
+	std::shared_ptr<const void> source {}; // (Whatever text lives in.)
+	std::vector<Entry> entries {};
+	std::list<std::size_t> recent {}; // Decoded elements, newest first.
+	std::size_t budget = 64 << 20;
+	std::size_t bytes = 0;
+	Stats counters {};
+
+	Index() = default;
+	void evict();
+	// Where a stroke element's '[' and ']' are, if nothing but its type
+	// comes before them, and no strings or other brackets are in between.
+	static auto payloadOf(std::string_view, std::size_t offset, std::size_t end)
+	-> std::optional<std::pair<std::size_t, std::size_t>>;
+
+public:
+	auto size() const -> std::size_t;
+	auto type(std::size_t) const -> std::size_t;
+	// Byte offset and length of the element in the text.
+	auto range(std::size_t) const -> std::pair<std::size_t, std::size_t>;
+	auto bounds(std::size_t) const -> std::optional<std::pair<Point,Point>>;
+	bool decoded(std::size_t) const;
+
+	// The element, decoded now if it isn't already.
+	auto element(std::size_t) -> Expected<std::shared_ptr<const Element>>;
+	// Every element decoded, (the same sketch parse() would give).
+	auto sketch() -> Expected<Sketch>;
+	// Same strokes Sketch::visit streams, but elements whose instances
+	// are all unwanted (and have been decoded before) aren't decoded
+	// again. Elements that don't decode are skipped, and the first one's
+	// error is given back, (index() only checks what's around atoms).
+	auto visit(StrokeVisitor&) -> std::optional<ParseError>;
+
+	void setBudget(std::size_t);
+	void clear(); // Drops every element that can be decoded again.
+	auto stats() const -> Stats;
+	void resetStats();
+};
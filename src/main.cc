@@ -4,7 +4,13 @@
 #include "window.hh"
 #include "external.hh"
 #include "renderer.hh"
+#include "damage.hh"
+#include "threadPool.hh"
+#include "history.hh"
+#include "journal.hh"
+#include "frameCache.hh"
 #include "parsers.hh"
+#include "mappedFile.hh"
 #include <iostream>
 #include <fstream>
 
@@ -18,21 +24,25 @@ struct AppState {
 		void clear() { *this = Signal {}; }
 	} signal;
 	
-	class History {
-		std::vector<const Sketch> states {Sketch {}};
-		std::size_t head = 0;
-	public:
-		const Sketch& view() { return states[head]; }
-		void look_back   () { head -= (head > 0); }
-		void look_forward() { head += (head < states.size()-1); }
-		void push(const Sketch& s) {
-			states.resize(++head);
-			states.push_back(s);
-		}
-	} history;
+	History history {};
+	// Every change gets written here as it happens, (for recovering
+	// from a crash without saving the whole sketch each time).
+	// (In the browser this lands in emscripten's in-memory filesystem,
+	// so it's only recovered from natively, not across page reloads.)
+	FileSink journalFile {"session.journal"};
+	Journal journal {journalFile};
 
 	Atom::Stroke currentStroke {};
 
+	// What's on screen right now, and which parts of it are stale.
+	// (The stroke being drawn is on screen too, but isn't in frame
+	// until it's committed.)
+	std::vector<SharedInstances> frame {};
+	Atom::FlatStroke liveStroke {};
+	Damage damage {};
+	FlattenCache flattened {};
+	FrameCache frames {};
+
 	Atom::Stroke::Point cursor {0, 0, 0.0};
 	bool pressed = false;
 	bool onScreen = false;
@@ -42,40 +52,83 @@ struct AppState {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 void draw(Window& w, Renderer& r, AppState& s) {
-	if (s.signal.undo) s.history.look_back();
-	if (s.signal.redo) s.history.look_forward();
+	static ThreadPool pool {};
+	if (s.signal.undo) s.history.look_back(), s.journal.undo();
+	if (s.signal.redo) s.history.look_forward(), s.journal.redo();
+
+	std::vector<Rect> updated {};
 
 	if (s.signal.mouseDown) {
 		s.currentStroke.points.clear();
 		s.currentStroke.diameter = s.brushSize;
 		s.currentStroke.points.push_back(s.cursor);
+		s.liveStroke.points = {{s.cursor.x, s.cursor.y}};
 	}
 
 	if (s.signal.mouseMove && s.pressed) {
 		s.currentStroke.points.push_back(s.cursor);
+		s.liveStroke.points.emplace_back(s.cursor.x, s.cursor.y);
+
+		// Ink just the newest segment, right onto the canvas.
+		// Blending is a min, so this adds up to the same pixels
+		// as drawing the whole stroke at once.
+		const auto& live = s.liveStroke.points;
+		const Atom::FlatStroke segment {{live.end()[-2], live.end()[-1]}};
+		r.displayRaw({&segment, 1});
+		updated.push_back(Renderer::bounds(segment));
 	}
 
 	if (s.signal.mouseUp) {
-		Sketch nextState = s.history.view();
-		auto& elements = nextState.elements;
+		s.history.commitStroke(s.currentStroke);
+		s.journal.commitStroke(s.currentStroke);
+		s.currentStroke.points.clear();
 
-		if (elements.size() == 0
-		||  !std::holds_alternative<Brush>(elements.back())) {
-			elements.push_back(Brush {});
+		// The stroke is already on screen, so the frame holds it
+		// now, and the comparison below finds nothing to redraw.
+		s.frame.push_back(std::make_shared<const FlatInstances>(
+			FlatStrokeAtoms {std::move(s.liveStroke)}
+		));
+		s.liveStroke.points.clear();
+	}
+
+	if (s.journal.wantsCheckpoint()) s.journal.checkpoint(s.history);
+
+	// Only a change in history can change the picture.
+	const bool changed = s.signal.undo || s.signal.redo || s.signal.mouseUp;
+	bool restored = false;
+	// (Just the pixels the renderer draws, not the pitch's padding.)
+	const auto screen = w.pixels.first(w.width() * w.height());
+	if (changed) {
+		auto next = s.history.view().renderInstances(s.flattened);
+		// Undo/redo to a state drawn recently just copies it back,
+		// (unless a stroke's being drawn, which the copy would lose).
+		restored = !s.signal.mouseUp && s.liveStroke.points.empty()
+		&&         s.frames.restore(s.history.id(), screen);
+		if (restored) {
+			s.damage.clear();
+			updated = {r.screen()};
+		}
+		else {
+			s.damage.addChanges(s.frame, next);
 		}
+		s.frame = std::move(next);
+	}
 
-		Brush& latestBrush = std::get<Brush>(elements.back());
-		latestBrush.atoms.push_back(
-			std::move(s.currentStroke)
-		);
+	// The frame matches history by now, so the repaint can stream
+	// straight out of the sketch. (frame is just for diffing.)
+	for (Rect rect : s.damage.regions()) {
+		r.clear(rect);
+		r.display(s.history.view(), rect, pool);
+		r.displayRaw({&s.liveStroke, 1}, rect);
+		updated.push_back(rect);
+	}
+	s.damage.clear();
 
-		s.currentStroke.points.clear();
-		s.history.push(nextState);
+	if (changed && !restored && s.liveStroke.points.empty()) {
+		s.frames.store(s.history.id(), screen);
 	}
 
-	r.clear();
-	r.displayRaw(s.history.view().render().strokes);
-	w.updatePixels();
+	if (!updated.empty()) w.updatePixels(updated);
 }
 
 bool detectEvents(AppState& s) {
@@ -143,27 +196,21 @@ int main() {
 	static AppState state {};
 	static Renderer renderer {
 		window.pixels, window.width(), window.height(),
-		[=](Col3 c) -> uint32_t {
-			return SDL_MapRGB(window.format, c.r, c.g, c.b);
-		},
-		[=](uint32_t pixel) -> Col3 {
-			Col3 c;
-			SDL_GetRGB(pixel, window.format, &c.r, &c.g, &c.b);
-			return c;
+		PixelFormat {
+			window.format->Rmask, window.format->Gmask,
+			window.format->Bmask, window.format->Amask,
 		}
 	};
 
-	// Gives a whole new meaning to 'if'stream, huh? :^)
-	if (std::ifstream input {"example file.hsc"}; !input) {
+	// Parsed right where it's mapped, (no copying it into a string).
+	if (auto input = MappedFile::open("example file.hsc"); !input) {
 		std::cerr << "File not found!.\n";
 	}
 	else {
-		std::istreambuf_iterator<char> it {input}, end {};
-		std::string inputString {it, end};
 		std::cout << "\n#### TOKENS ####\n";
-		SketchFormat::printTokens(inputString);
+		SketchFormat::printTokens(input->view());
 		std::cout << "\n#### ELEMENTS ####\n";
-		if (auto sketch = SketchFormat::parse(inputString)) {
+		if (auto sketch = SketchFormat::parse(input)) {
 			std::cout << *sketch << "\n";
 			state.history.push(*sketch);
 		}
@@ -175,6 +222,17 @@ int main() {
 		std::cout << "\n#### END ####\n";
 	}
 
+	// Pick up where the last session left off, if it left anything.
+	if (auto saved = MappedFile::open("session.journal")) {
+		if (!saved->view().empty()) {
+			state.history = Journal::replay(saved->view());
+		}
+	}
+	state.journal.checkpoint(state.history);
+
+	state.frame = state.history.view().renderInstances(state.flattened);
+	state.damage.add(renderer.screen());
+
 #	ifdef __EMSCRIPTEN__
 		JS::listenForPenPressure();
 		// JS::listenForClipboard();
@@ -0,0 +1,29 @@
+#include "mappedFile.hh"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+auto MappedFile::open(const std::string& path)
+-> std::shared_ptr<const MappedFile> {
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return nullptr;
+
+	std::shared_ptr<MappedFile> result {new MappedFile {}};
+	struct stat info {};
+	if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+		void* p = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED) {
+			result->data = static_cast<const char*>(p);
+			result->size = info.st_size;
+		}
+		else result = nullptr;
+	}
+	// (The mapping outlives the descriptor.)
+	::close(fd);
+	return result;
+}
+
+MappedFile::~MappedFile() {
+	if (data) ::munmap(const_cast<char*>(data), size);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// A whole file mapped read-only into memory, so it can be parsed where
+// it lies instead of copied into a string first. It's unmapped once the
+// last shared_ptr to it goes, (a Sketch parsed from it holds one).
+class MappedFile {
+	const char* data = nullptr;
+	std::size_t size = 0;
+
+	MappedFile() = default;
+
+public:
+	// Nothing if the file can't be opened or mapped.
+	static auto open(const std::string& path) -> std::shared_ptr<const MappedFile>;
+
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	auto view() const -> std::string_view { return {data, size}; }
+};
@@ -20,6 +20,7 @@ protected:
 		ModUppercaseSize, MalformedModUppercase,
 		TickmarkOrdering, SignCharacter, NumberSize, NumberError,
 		MalformedNumberTuple,
+		BinaryMagic, BinaryVersion, BinaryTruncated, BinaryMalformed,
 	};
 
 public:
@@ -40,6 +41,9 @@ protected:
 	struct Token {
 		std::string_view string;
 		SourcePos pos;
+		// For a '[', how many tokens on its ']' is, (found by the
+		// tokenizer, and 0 if it's never closed).
+		std::size_t match = 0;
 
 		constexpr bool operator==(const Token& other) const {
 			return this->string == other.string;
@@ -1,118 +1,246 @@
 #include "parsers.hh"
 #include "util.hh"
+#include <array>
+#include <bit>
 #include <string>
-#include <stack>
 #include <optional>
+#include <utility>
 
 /* ~~ Raw Parser ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 auto RawFormat::parse(std::string_view str)
 -> Expected<FlatSketch> {
-	return rawParse(tokenize(str));
-}
-
-auto RawFormat::tokenize(std::string_view str)
--> std::vector<Token> {
-	std::vector<Token> result {};
-	for (std::size_t i=0, j=0; i<str.size(); i=j) {
-		while (i < str.size() && isWhitespace(str[i])) i++;
-		if (i == str.size()) break;
-		j = i;
-		while (j < str.size() && !isWhitespace(str[j])) j++;
-		result.emplace_back(str.substr(i, j-i));
+	Reader reader {str};
+	FlatSketch result {};
+	while (true) {
+		auto stroke = reader.next();
+		if (!stroke) return Unexpected(stroke.error());
+		if (!*stroke) return result;
+		result.strokes.push_back(std::move(**stroke));
 	}
-
-	return result;
 }
 
-auto RawFormat::rawParse(TokenSpan tokens)
+auto RawFormat::parse(std::istream& is)
 -> Expected<FlatSketch> {
+	Reader reader {is};
 	FlatSketch result {};
-
-	for (Token tkn : tokens) {
-		Atom::FlatStroke stroke {};
-		auto points = Base36::parseTuples(
-			tkn.string,
-			+[](Base36::Number_t<2,unsigned> x
-			,   Base36::Number_t<2,unsigned> y) {
-				return Atom::FlatStroke::Point {int(*x), int(*y)};
-			}
-		);
-		if (!points) return Unexpected(MalformedNumberTuple, tkn);
-		
-		result.strokes.emplace_back(*points);
+	while (true) {
+		auto stroke = reader.next();
+		if (!stroke) return Unexpected(stroke.error());
+		if (!*stroke) return result;
+		result.strokes.push_back(std::move(**stroke));
 	}
+}
 
-	return result;
+auto RawFormat::strokeParse(Token tkn)
+-> Expected<Atom::FlatStroke> {
+	auto points = Base36::parseTuples(
+		tkn.string,
+		+[](Base36::Number_t<2,unsigned> x
+		,   Base36::Number_t<2,unsigned> y) {
+			return Atom::FlatStroke::Point {int(*x), int(*y)};
+		}
+	);
+	if (!points) return Unexpected(MalformedNumberTuple, tkn);
+	return Atom::FlatStroke {std::move(*points)};
 }
 
 void RawFormat::print(std::ostream& os, const FlatSketch& sketch) {
-	for (const auto& s : sketch.strokes) {
-		os << " ";
-		for (const auto& p : s.points) {
-			os << Base36::toString<2,unsigned>(p.x)
-			   << Base36::toString<2,unsigned>(p.y);
-		}
+	TextWriter {os}.writeRaw(sketch);
+}
+
+/* ~~ Raw Reader ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+RawFormat::Reader::Reader(std::istream& is)
+: stream{&is} {}
+
+RawFormat::Reader::Reader(std::string_view str)
+: input{str} {}
+
+auto RawFormat::Reader::more() -> bool {
+	if (!stream) return false;
+
+	// Same as SketchFormat::Reader, keeping just what's not read yet.
+	buffer.erase(0, buffer.size() - input.size());
+	const std::size_t kept = buffer.size();
+	const std::size_t wanted = std::max(ChunkSize, kept);
+	buffer.resize(kept + wanted);
+	stream->read(buffer.data() + kept, wanted);
+	buffer.resize(kept + stream->gcount());
+	input = buffer;
+	return buffer.size() > kept;
+}
+
+auto RawFormat::Reader::next()
+-> Expected<std::optional<Atom::FlatStroke>> {
+	// Whitespace up to the stroke, then all of the stroke, reading
+	// more whenever either runs into the end of what's been read.
+	while (true) {
+		std::size_t i = 0;
+		while (i < input.size() && isWhitespace(input[i])) pos.next(input[i++]);
+		input.remove_prefix(i);
+		if (!input.empty() || !more()) break;
 	}
+	if (input.empty()) return std::nullopt;
+
+	std::size_t length = 0;
+	while (true) {
+		while (length < input.size() && !isWhitespace(input[length])) length++;
+		if (length < input.size() || !more()) break;
+	}
+
+	const Token stroke {input.substr(0, length), pos};
+	pos.col += length; // (No newlines in it.)
+	input.remove_prefix(length);
+	return strokeParse(stroke);
 }
 
 /* ~~ Sketch Parser ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 auto SketchFormat::parse(std::string_view str)
 -> Expected<Sketch> {
-	auto tokens = tokenize(str);
-	if (!tokens) return Unexpected(tokens.error());
-	return sketchParse(*tokens);
+	Reader reader {str};
+	Sketch result {};
+	while (true) {
+		auto element = reader.next();
+		if (!element) return Unexpected(element.error());
+		if (!*element) return result;
+		result.elements.push_back(std::move(**element));
+	}
+}
+
+auto SketchFormat::parse(std::istream& is)
+-> Expected<Sketch> {
+	Reader reader {is};
+	Sketch result {};
+	while (true) {
+		auto element = reader.next();
+		if (!element) return Unexpected(element.error());
+		if (!*element) return result;
+		result.elements.push_back(std::move(**element));
+	}
+}
+
+auto SketchFormat::parse(std::string_view str, ThreadPool& pool)
+-> Expected<Sketch> {
+	if (pool.size() == 1) return parse(str);
+	const auto starts = elementStarts(str);
+
+	// Runs of whole elements, about the same size, a few per thread.
+	struct Run { std::size_t first, last; };
+	std::vector<Run> runs {};
+	const std::size_t target = std::max(str.size() / (8*pool.size()), 1uz << 16);
+	for (std::size_t i=0, j=0; i<starts.size(); i=j) {
+		while (++j < starts.size() && starts[j].offset - starts[i].offset < target) {}
+		runs.push_back({i, j});
+	}
+
+	std::vector<Expected<std::optional<Element>>> elements (starts.size());
+	pool.parallelFor(runs.size(), [&](std::size_t r) {
+		const auto [first, last] = runs[r];
+		const auto [offset, pos] = starts[first];
+		Reader reader = first == 0 ? Reader {str} : Reader {str.substr(offset), pos};
+		for (std::size_t i=first; i<last; i++) elements[i] = reader.next();
+	});
+
+	// In order, so the first error in the file is the one reported.
+	Sketch result {};
+	for (auto& element : elements) {
+		if (!element) return Unexpected(element.error());
+		if (!*element) break;
+		result.elements.push_back(std::move(**element));
+	}
+	return result;
+}
+
+auto SketchFormat::parse(std::shared_ptr<const MappedFile> file)
+-> Expected<Sketch> {
+	auto result = parse(file->view());
+	if (result) result->source = std::move(file);
+	return result;
+}
+
+auto SketchFormat::parse(std::shared_ptr<const MappedFile> file, ThreadPool& pool)
+-> Expected<Sketch> {
+	auto result = parse(file->view(), pool);
+	if (result) result->source = std::move(file);
+	return result;
 }
 
 void SketchFormat::print(std::ostream& os, const Sketch& s) {
-	os << s;
+	TextWriter {os}.write(s);
 }
 
-auto SketchFormat::tokenize(std::string_view str)
--> Expected<std::vector<Token>> {
-	std::vector<Token> result {};
-	SourcePos pos {1,1};
+void SketchFormat::print(std::string& str, const Sketch& s) {
+	TextWriter {str}.write(s);
+}
 
+auto SketchFormat::tokenizerStep(
+	TokenizerState state, char c, int& parenCount
+) -> TokenizerState {
+	if (state == LineStart && c == '%') return Comment;
+	if (state == Comment)
+		return isNewline(c) ? LineStart : Comment;
+	if (state == String) {
+		if (c == '(') ++parenCount;
+		if (c == ')' && --parenCount <= 0) return StringEnd;
+		return String;
+	}
+
+	if (isNewline(c))          return LineStart;
+	if (isWhitespace(c))       return Space;
+	if (Util::isAny(c,"[],;")) return Operator;
+	if (c == '(')              return String;
+	else /* default:        */ return NumOrType;
+}
+
+auto SketchFormat::tokenize(
+	std::string_view str,
+	std::vector<Token>& result,
+	SourcePos& pos,
+	TokenizerState startState
+) -> Expected<std::size_t> {
 	auto resultPush = [&](std::size_t i, std::size_t j) {
 		// TODO: Improve token pos accuracy.
 		result.emplace_back(str.substr(i, j-i), pos);
 	};
 
-	enum State {
-		LineStart, Comment, Space, End,
-		NumOrType, String, StringEnd, Operator,
-	}
-	prevState = LineStart,
-	nextState = LineStart;
+	// Open '['s make a stack, linked through their match fields, (each
+	// holding the index+1 of the one it's inside), until closed.
+	std::size_t open = 0;
+	auto bracketPushed = [&] {
+		const std::size_t k = result.size()-1;
+		if (result[k].string == "[") {
+			result[k].match = std::exchange(open, k+1);
+		}
+		else if (result[k].string == "]" && open) {
+			const std::size_t j = open-1;
+			open = std::exchange(result[j].match, k-j);
+		}
+	};
+	auto unclosed = [&] {
+		while (open) open = std::exchange(result[open-1].match, 0);
+	};
+
+	TokenizerState
+	prevState = startState,
+	nextState = startState;
 
 	std::size_t tokenStart=0;
 	int parenCount = 0;
 	for (std::size_t i=0
 	;    i<=str.size()
-	;    pos.next(str[i++]), prevState = nextState) {
-		nextState = i==str.size() ? End :
-		[&](auto state, char c) {
-			if (state == LineStart && c == '%') return Comment;
-			if (state == Comment)
-				return isNewline(c) ? LineStart : Comment;
-			if (state == String) {
-				if (c == '(') ++parenCount;
-				if (c == ')' && --parenCount <= 0) return StringEnd;
-				return String;
-			}
-
-			if (isNewline(c))          return LineStart;
-			if (isWhitespace(c))       return Space;
-			if (Util::isAny(c,"[],;")) return Operator;
-			if (c == '(')              return String;
-			else /* default:        */ return NumOrType;
-		} (prevState, str[i]);
-
+	;    i++, prevState = nextState) {
+		nextState = i==str.size() ? End
+		: tokenizerStep(prevState, str[i], parenCount);
 
 		if (prevState == Operator) {
 			resultPush(i-1, i);
-			if (str[i-1] == ';') return result;
+			if (Util::isAny(str[i-1], ",;")) {
+				unclosed();
+				return i;
+			}
+			bracketPushed();
 		}
 
 		if (prevState != nextState) {
@@ -125,37 +253,135 @@ auto SketchFormat::tokenize(std::string_view str)
 			if (prevState == String && nextState == End)
 				return Unexpected(UnbalancedString, pos);
 		}
+
+		if (i < str.size()) pos.next(str[i]);
 	}
 
-	return result;
+	unclosed();
+	return std::string_view::npos;
 }
 
-/* ~~ Top-level Parsers ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+auto SketchFormat::elementStarts(std::string_view str)
+-> std::vector<ElementStart> {
+	std::vector<ElementStart> result {{0, {1,1}}};
 
-auto SketchFormat::sketchParse(TokenSpan tokens)
--> Expected<Sketch> {
-	if (tokens.empty()) return Unexpected(EmptyFile);
-	if (!Util::contains(tokens, Token {";"})) {
-		return Unexpected(MissingSemicolon, tokens.back());
+	// Same rules as tokenizerStep(), (so commas in comments and strings
+	// don't count), but only stopping at the few chars that matter.
+	constexpr auto special = [] {
+		std::array<bool, 256> table {};
+		for (char c : "\n\r(),;%"sv) table[uint8_t(c)] = true;
+		return table;
+	} ();
+
+	enum { Normal, Comment, String } mode = Normal;
+	int parenCount = 0;
+	std::size_t row = 1, lineStart = 0;
+	auto posAfter = [&](std::size_t i) {
+		// (The first line's columns start at 1, the rest at 0.)
+		return SourcePos {row, i+1 - lineStart + (row == 1)};
+	};
+
+	for (std::size_t i=0; i<str.size(); i++) {
+		const char c = str[i];
+		if (!special[uint8_t(c)]) continue;
+		if (c == '\n') row++, lineStart = i+1;
+
+		switch (mode) {
+		case Comment:
+			if (isNewline(c)) mode = Normal;
+			break;
+		case String:
+			if (c == '(') ++parenCount;
+			if (c == ')' && --parenCount <= 0) mode = Normal;
+			break;
+		case Normal:
+			if (c == '%' && (i == 0 || isNewline(str[i-1]))) mode = Comment;
+			if (c == '(') mode = String, parenCount = 1;
+			if (c == ',') result.push_back({i+1, posAfter(i)});
+			if (c == ';') return result;
+			break;
+		}
 	}
-	const auto delimEnd = ranges::find(tokens, Token {";"});
 
-	Sketch result {};
+	return result;
+}
+
+/* ~~ Streaming Reader ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+SketchFormat::Reader::Reader(std::istream& is)
+: stream{&is} {}
 
-	for (auto it = tokens.begin(); it != delimEnd; /**/) {
-		if (*it == Token {","} && it != tokens.begin()) ++it;
-		const auto delimNext = std::find(it, tokens.end(), Token {","});
-		const auto delim = Util::min(delimNext, delimEnd);
+SketchFormat::Reader::Reader(std::string_view str)
+: input{str} {}
 
-		auto element = elementParse(Util::subspan(tokens, it, delim));
-		if (!element) return Unexpected(element.error(), *it);
-		result.elements.push_back(*element);
-		it = delim;
+SketchFormat::Reader::Reader(std::string_view rest, SourcePos pos)
+: input{rest}, startState{Space}, startPos{pos}, lastComma{pos}, first{false} {}
+
+auto SketchFormat::Reader::more() -> bool {
+	if (!stream) return false;
+
+	// Drop everything before the current element, then read at least
+	// as much again as is left, (so one huge element isn't tokenized
+	// from its start over and over).
+	buffer.erase(0, input.data() - buffer.data());
+	const std::size_t kept = buffer.size();
+	const std::size_t wanted = std::max(ChunkSize, kept);
+	buffer.resize(kept + wanted);
+	stream->read(buffer.data() + kept, wanted);
+	buffer.resize(kept + stream->gcount());
+	input = buffer;
+	return buffer.size() > kept;
+}
+
+auto SketchFormat::Reader::next()
+-> Expected<std::optional<Element>> {
+	if (done) return std::nullopt;
+
+	// Tokenize up to the ',' or ';' that ends this element, reading
+	// more (and starting over) until there is one, (or isn't any more).
+	SourcePos pos;
+	auto attempt = [&] {
+		tokens.clear();
+		pos = startPos;
+		return tokenize(input, tokens, pos, startState);
+	};
+	auto length = attempt();
+	while ((!length || *length == std::string_view::npos) && more()) {
+		length = attempt();
 	}
 
-	return result;
+	if (!length) return done = true, Unexpected(length.error());
+	if (*length == std::string_view::npos) {
+		// Out of input without a ';', so it's an error either way.
+		done = true;
+		if (!tokens.empty()) return Unexpected(MissingSemicolon, tokens.back());
+		if (lastComma) return Unexpected(MissingSemicolon, *lastComma);
+		return Unexpected(EmptyFile);
+	}
+
+	// (Operator and Space states step the same, but Space pushes nothing.)
+	const Token delimiter = tokens.back();
+	input.remove_prefix(*length);
+	startPos = pos, startState = Space;
+	if (delimiter.string == ",") lastComma = pos;
+	if (delimiter.string == ";") done = true;
+	const bool wasFirst = std::exchange(first, false);
+
+	if (tokens.size() == 1) {
+		// A lone ';' is an empty sketch, an empty element is not.
+		if (delimiter.string == ";" && wasFirst) return std::nullopt;
+		return Unexpected(EmptyElement, delimiter);
+	}
+
+	// Some errors point one past the element's last token, which is
+	// its delimiter, so that's left on the end, just outside the span.
+	auto element = elementParse(TokenSpan {tokens}.first(tokens.size()-1));
+	if (!element) return Unexpected(element.error(), tokens[0]);
+	return std::move(*element);
 }
 
+/* ~~ Top-level Parsers ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 auto SketchFormat::elementParse(TokenSpan tokens)
 -> Expected<Element> {
 	if (tokens.empty()) return Unexpected(EmptyElement);
@@ -215,11 +441,12 @@ auto SketchFormat::atomStrokeBrushParse(TokenSpan tokens)
 	auto diameter = Base36::parse<2,unsigned>(tokens[0].string);
 	if (!diameter) return Unexpected(ForeignDigit, tokens[0]);
 
-	auto strokeStr = removeTicks(tokens[1].string);
-	if (!strokeStr) return Unexpected(strokeStr.error(), tokens[1]);
+	if (!ticksValid(tokens[1].string)) {
+		return Unexpected(TickmarkOrdering, tokens[1]);
+	}
 
 	auto points = Base36::parseTuples(
-		*strokeStr,
+		tokens[1].string, Tick,
 		+[](Base36::Number_t<3,  signed> x
 		,   Base36::Number_t<3,  signed> y
 		,   Base36::Number_t<2,unsigned> p) {
@@ -235,11 +462,12 @@ auto SketchFormat::atomStrokeDataParse(TokenSpan tokens)
 -> Expected<Atom::FlatStroke> {
 	if (tokens.size() != 1) return Unexpected(AtomSize);
 
-	auto strokeStr = removeTicks(tokens[0].string);
-	if (!strokeStr) return Unexpected(strokeStr.error(), tokens[0]);
+	if (!ticksValid(tokens[0].string)) {
+		return Unexpected(TickmarkOrdering, tokens[0]);
+	}
 	
 	auto points = Base36::parseTuples(
-		*strokeStr,
+		tokens[0].string, Tick,
 		+[](Base36::Number_t<3,signed> x
 		,   Base36::Number_t<3,signed> y) {
 			return Atom::FlatStroke::Point {*x, *y};
@@ -254,11 +482,12 @@ auto SketchFormat::atomStrokeRawParse(TokenSpan tokens)
 -> Expected<Atom::FlatStroke> {
 	if (tokens.size() != 1) return Unexpected(AtomSize);
 
-	auto strokeStr = removeTicks(tokens[0].string);
-	if (!strokeStr) return Unexpected(strokeStr.error(), tokens[0]);
+	if (!ticksValid(tokens[0].string)) {
+		return Unexpected(TickmarkOrdering, tokens[0]);
+	}
 	
 	auto points = Base36::parseTuples(
-		*strokeStr,
+		tokens[0].string, Tick,
 		+[](Base36::Number_t<2,unsigned> x
 		,   Base36::Number_t<2,unsigned> y) {
 			return Atom::FlatStroke::Point {signed(*x), signed(*y)};
@@ -372,46 +601,16 @@ auto SketchFormat::modUppercaseParse(TokenSpan tokens)
 auto SketchFormat::parenParse(TokenSpan tokens, TokenIter& it)
 -> Expected<TokenSpan> {
 	if (isStringLiteral(*it)) return TokenSpan {it++, 1uz};
+	if (*it != Token {"["}) return Unexpected(MissingBracketLeft, *it);
 
-	constexpr std::array parenTypes {
-		std::pair {Token {"["}, Token {"]"}},
-		/* reserved for future types */
-	};
-
-	struct Paren { std::size_t id; enum { Left, Right } side; };
-	auto parenTypeOf = [&](Token tkn) -> std::optional<Paren> {
-		for (std::size_t i=0; i<parenTypes.size(); i++) {
-			auto [left,right] = parenTypes[i];
-			if (tkn == left ) return Paren {i, Paren::Left };
-			if (tkn == right) return Paren {i, Paren::Right};
-		}
-		return std::nullopt;
-	};
-
-	if (auto t = parenTypeOf(*it); !t || t->side != Paren::Left) {
-		return Unexpected(MissingBracketLeft, *it);
-	}
-
-	std::stack<Paren> stack {};
+	// The tokenizer's already matched it up with its ']'.
 	const auto start = it;
+	if (start->match == 0 || start->match >= std::size_t(tokens.end() - start)) {
+		return Unexpected(MissingBracketRight, tokens.back());
+	}
+	std::advance(it, start->match + 1);
 
-	do if (auto t = parenTypeOf(*it++)) {
-		if (t->side == Paren::Left ) stack.push(*t);
-		if (t->side == Paren::Right) {
-			if (t->id != stack.top().id) {
-				return Unexpected(MismatchingParens, *it);
-			}
-			stack.pop();
-		}
-	} while (!stack.empty() && it!=tokens.end());
-
-	TokenSpan result {Util::subspan(tokens,
-		std::next(start),
-		std::prev(it)
-	)};
-	if (stack.empty()) return result;
-
-	return Unexpected(MissingBracketRight, tokens.back());
+	return Util::subspan(tokens, std::next(start), std::prev(it));
 }
 
 auto SketchFormat::isStringLiteral(const Token tkn) -> bool {
@@ -420,24 +619,11 @@ auto SketchFormat::isStringLiteral(const Token tkn) -> bool {
 	&&     tkn.string.back()  == ')';
 }
 
-auto SketchFormat::removeTicks(std::string_view str)
--> Expected<std::string> {
-	std::string result {str};
-	constexpr char Tick = '\'';
-
-	if (!result.empty()
-	&& (result.front() == Tick
-	||  result.back() == Tick
-	||  result.contains(std::string(2, Tick)))) {
-		return Unexpected(TickmarkOrdering);
-	}
-
-	auto isNotTick = [](char c) { return c != Tick; };
-
-	return result
-		| views::filter(isNotTick)
-		| views::transform(Util::toLower)
-		| ranges::to<std::string>();
+auto SketchFormat::ticksValid(std::string_view str) -> bool {
+	return str.empty()
+	|| (str.front() != Tick
+	&&  str.back()  != Tick
+	&&  !str.contains("''"));
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -452,15 +638,319 @@ std::ostream& operator<<(
 }
 
 auto SketchFormat::printTokens(std::string_view str) -> void {
-	auto tokens = tokenize(str);
-	if (tokens) {
-		for (Token t : *tokens) {
-			std::cout << "\t\"" << t.string << "\"\n";
+	std::vector<Token> tokens {};
+	SourcePos pos {1,1};
+	TokenizerState state = LineStart;
+	// An element at a time, up to the ';'.
+	while (true) {
+		auto length = tokenize(str, tokens, pos, state);
+		if (!length) {
+			std::cout << "\t!! Invalid tokens input !!\n";
+			std::cout << "\tError code:  " << int(length.error()) << "\n";
+			std::cout << "\tAt Position: " << length.error().pos << "\n";
+			return;
 		}
+		if (*length == std::string_view::npos
+		||  tokens.back().string == ";") break;
+		str.remove_prefix(*length);
+		state = Space;
+	}
+
+	for (Token t : tokens) {
+		std::cout << "\t\"" << t.string << "\"\n";
+	}
+}
+/* ~~ Binary Format ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+// "hscb", a version byte, the element count, then a table of each
+// element's type byte and body length, followed by the bodies:
+//   Brush        strokes, each (diameter, points, then per point the
+//                xy step and the pressure step), then modifiers
+//   Pencil/Data  the same, without diameters and pressures
+//   Marker       text length and text, then modifiers
+// Counts and lengths are varints, (7 bits a byte, low bits first). A
+// step is from the element's previous point, (0,0 to start with), and
+// zigzagged so small negatives stay small. dx and dy are interleaved
+// bit by bit into one varint, so a step of up to 3 pixels fits in one
+// byte. Modifiers are a type byte, then for Array its N, and then
+// the matrix as 9 little-endian doubles.
+
+namespace
+{
+	auto zigzag(int32_t n) -> uint32_t { return uint32_t(n) << 1 ^ uint32_t(n >> 31); }
+	auto unzigzag(uint32_t n) -> int32_t { return int32_t(n >> 1 ^ -(n & 1)); }
+
+	// Spreads the bits of n out to every other bit, and back.
+	auto spread(uint32_t n) -> uint64_t {
+		uint64_t x = n;
+		x = (x | x << 16) & 0x0000ffff0000ffff;
+		x = (x | x <<  8) & 0x00ff00ff00ff00ff;
+		x = (x | x <<  4) & 0x0f0f0f0f0f0f0f0f;
+		x = (x | x <<  2) & 0x3333333333333333;
+		x = (x | x <<  1) & 0x5555555555555555;
+		return x;
+	}
+	auto unspread(uint64_t x) -> uint32_t {
+		x &= 0x5555555555555555;
+		x = (x | x >>  1) & 0x3333333333333333;
+		x = (x | x >>  2) & 0x0f0f0f0f0f0f0f0f;
+		x = (x | x >>  4) & 0x00ff00ff00ff00ff;
+		x = (x | x >>  8) & 0x0000ffff0000ffff;
+		x = (x | x >> 16) & 0x00000000ffffffff;
+		return uint32_t(x);
 	}
-	else {
-		std::cout << "\t!! Invalid tokens input !!\n";
-		std::cout << "\tError code:  " << int(tokens.error()) << "\n";
-		std::cout << "\tAt Position: " << tokens.error().pos << "\n";
+
+	// (Steps wrap around, so any int is one step from any other.)
+	auto step(int from, int to) -> uint32_t { return zigzag(int32_t(uint32_t(to) - uint32_t(from))); }
+	auto stepped(int from, uint32_t by) -> int { return int32_t(uint32_t(from) + uint32_t(unzigzag(by))); }
+
+	void putVarint(std::string& out, uint64_t n) {
+		for (; n >= 0x80; n >>= 7) out += char(n | 0x80);
+		out += char(n);
+	}
+
+	void putFloat64(std::string& out, double d) {
+		const auto bits = std::bit_cast<uint64_t>(d);
+		for (int i=0; i<64; i+=8) out += char(bits >> i);
+	}
+
+	void putStrokeMods(std::string& out, const StrokeModifiers& mods) {
+		putVarint(out, mods.size());
+		for (const auto& mod : mods) std::visit(Util::Overloaded {
+			[&](const Mod::Affine& affine) {
+				out += char(BinaryFormat::AffineMod);
+				for (double d : affine.matrix) putFloat64(out, d);
+			},
+			[&](const Mod::Array& array) {
+				out += char(BinaryFormat::ArrayMod);
+				putVarint(out, array.N);
+				for (double d : array.transformation.matrix) putFloat64(out, d);
+			},
+		}, mod);
 	}
-}
\ No newline at end of file
+
+	void putBody(std::string& out, const Element& variant) {
+		std::visit([&]<typename T>(const T& elem) {
+			if constexpr (HoldsStrokeAtoms<T>) {
+				putVarint(out, elem.atoms.size());
+				int x = 0, y = 0, p = 0;
+				for (const StrokeAtoms::View s : elem.atoms) {
+					putVarint(out, s.diameter);
+					putVarint(out, s.size());
+					for (std::size_t i=0; i<s.size(); i++) {
+						putVarint(out, spread(step(x, s.x[i])) | spread(step(y, s.y[i])) << 1);
+						putVarint(out, step(p, s.pressure[i]));
+						x = s.x[i], y = s.y[i], p = s.pressure[i];
+					}
+				}
+				putStrokeMods(out, elem.modifiers);
+			}
+			else if constexpr (HoldsFlatStrokeAtoms<T>) {
+				putVarint(out, elem.atoms.size());
+				Atom::FlatStroke::Point last {0, 0};
+				for (const Atom::FlatStroke& s : elem.atoms) {
+					putVarint(out, s.points.size());
+					for (const auto point : s.points) {
+						putVarint(out, spread(step(last.x, point.x)) | spread(step(last.y, point.y)) << 1);
+						last = point;
+					}
+				}
+				putStrokeMods(out, elem.modifiers);
+			}
+			else if constexpr (HoldsMarkerAtom<T>) {
+				putVarint(out, elem.atoms.text.size());
+				out += elem.atoms.text;
+				putVarint(out, elem.modifiers.size());
+				for (const auto& mod : elem.modifiers) {
+					std::visit([&](const Mod::Uppercase&) { out += char(BinaryFormat::UppercaseMod); }, mod);
+				}
+			}
+		}, variant);
+	}
+}
+
+void BinaryFormat::print(std::ostream& os, const Sketch& sketch) {
+	// Bodies first, so the table can say how long each one is.
+	std::string table {}, bodies {};
+	putVarint(table, sketch.elements.size());
+	for (const Element& element : sketch.elements) {
+		const std::size_t start = bodies.size();
+		putBody(bodies, element);
+		table += char(
+			  std::holds_alternative<Brush >(element) ? BrushType
+			: std::holds_alternative<Pencil>(element) ? PencilType
+			: std::holds_alternative<Data  >(element) ? DataType
+			: /* Marker                            */   MarkerType
+		);
+		putVarint(table, bodies.size() - start);
+	}
+
+	os << Magic << char(Version);
+	os.write(table.data(), table.size());
+	os.write(bodies.data(), bodies.size());
+}
+
+auto BinaryFormat::parse(std::string_view str)
+-> Expected<Sketch> {
+	if (!str.starts_with(Magic)) return Unexpected(BinaryMagic, SourcePos {1,1});
+	Cursor in {str, Magic.size(), str.size()};
+	if (in.byte() != Version) return Unexpected(BinaryVersion, SourcePos {1, Magic.size()+1});
+
+	// (Every table entry is at least 2 bytes, and every body 2 more.)
+	const std::size_t count = in.varint();
+	if (in.truncated || count > in.left()/4) return Unexpected(BinaryTruncated, in.pos());
+	struct Entry { Type type; std::size_t length; };
+	std::vector<Entry> table (count);
+	for (Entry& entry : table) {
+		const SourcePos pos = in.pos();
+		entry = {Type(in.byte()), in.varint()};
+		if (entry.type > MarkerType) return Unexpected(BinaryMalformed, pos);
+	}
+	if (in.truncated) return Unexpected(BinaryTruncated, in.pos());
+
+	Sketch result {};
+	std::size_t offset = in.at;
+	for (const auto [type, length] : table) {
+		if (length > str.size() - offset) return Unexpected(BinaryTruncated, SourcePos {1, offset+1});
+		Cursor body {str, offset, offset + length};
+		auto element = elementParse(type, body);
+		if (!element) return Unexpected(element.error());
+		if (body.truncated) return Unexpected(BinaryTruncated, body.pos());
+		if (body.left()) return Unexpected(BinaryMalformed, body.pos());
+		result.elements.push_back(std::move(*element));
+		offset += length;
+	}
+	return result;
+}
+
+auto BinaryFormat::elementParse(Type type, Cursor& in)
+-> Expected<Element> {
+	switch (type) {
+	case BrushType : return strokesParse<Brush >(in);
+	case PencilType: return strokesParse<Pencil>(in);
+	case DataType  : return strokesParse<Data  >(in);
+	case MarkerType: break;
+	}
+
+	const std::size_t length = in.varint();
+	if (length > in.left()) return Unexpected(BinaryTruncated, in.pos());
+	Marker marker {{{std::string {in.bytes(length)}}, {}}};
+	auto modifiers = modsMarkerParse(in);
+	if (!modifiers) return Unexpected(modifiers.error());
+	marker.modifiers = std::move(*modifiers);
+	return marker;
+}
+
+template <typename Element_t>
+auto BinaryFormat::strokesParse(Cursor& in)
+-> Expected<Element> {
+	constexpr bool Pressure = HoldsStrokeAtoms<Element_t>;
+	Element_t result {};
+
+	// (Each point takes at least a byte per step.)
+	const std::size_t strokes = in.varint();
+	if (strokes > in.left()) return Unexpected(BinaryTruncated, in.pos());
+	result.atoms.reserve(strokes);
+
+	int x = 0, y = 0, p = 0;
+	Atom::Stroke brushStroke {}; // (Reused.)
+	for (std::size_t i=0; i<strokes; i++) {
+		const SourcePos pos = in.pos();
+		const std::size_t diameter = Pressure ? in.varint() : 0;
+		const std::size_t points = in.varint();
+		if (in.truncated || points > in.left() / (1 + Pressure)) {
+			return Unexpected(BinaryTruncated, pos);
+		}
+
+		Atom::FlatStroke flatStroke {};
+		if constexpr (Pressure) brushStroke = {unsigned(diameter), {}};
+		if constexpr (Pressure) brushStroke.points.reserve(points);
+		else flatStroke.points.reserve(points);
+
+		bool inRange = diameter <= UINT16_MAX;
+		for (std::size_t j=0; j<points; j++) {
+			const uint64_t xy = in.varint();
+			x = stepped(x, unspread(xy)), y = stepped(y, unspread(xy >> 1));
+			if constexpr (Pressure) {
+				p = stepped(p, in.varint());
+				inRange &= INT16_MIN <= std::min(x,y) && std::max(x,y) <= INT16_MAX
+				&&         0 <= p && p <= int(StrokeAtoms::PressureMax);
+				brushStroke.points.emplace_back(x, y, p / double(StrokeAtoms::PressureMax));
+			}
+			else flatStroke.points.emplace_back(x, y);
+		}
+		if (in.truncated) return Unexpected(BinaryTruncated, in.pos());
+		if (!inRange) return Unexpected(BinaryMalformed, pos);
+
+		if constexpr (Pressure) result.atoms.push_back(brushStroke);
+		else result.atoms.push_back(std::move(flatStroke));
+	}
+
+	auto modifiers = modsStrokeParse(in);
+	if (!modifiers) return Unexpected(modifiers.error());
+	result.modifiers = std::move(*modifiers);
+	return result;
+}
+
+auto BinaryFormat::modsStrokeParse(Cursor& in)
+-> Expected<StrokeModifiers> {
+	// (Each modifier's at least 9 doubles.)
+	const std::size_t count = in.varint();
+	if (count > in.left() / 72) return Unexpected(BinaryTruncated, in.pos());
+	StrokeModifiers result {};
+	for (std::size_t i=0; i<count; i++) {
+		const SourcePos pos = in.pos();
+		const uint8_t type = in.byte();
+		const std::size_t N = type == ArrayMod ? in.varint() : 1;
+		std::array<double,9> matrix;
+		for (double& d : matrix) d = in.float64();
+
+		if (in.truncated) return Unexpected(BinaryTruncated, in.pos());
+		if (type == AffineMod) result.push_back(Mod::Affine {matrix});
+		else if (type == ArrayMod) result.push_back(Mod::Array {N, matrix});
+		else return Unexpected(BinaryMalformed, pos);
+	}
+	return result;
+}
+
+auto BinaryFormat::modsMarkerParse(Cursor& in)
+-> Expected<MarkerModifiers> {
+	const std::size_t count = in.varint();
+	if (count > in.left()) return Unexpected(BinaryTruncated, in.pos());
+	MarkerModifiers result {};
+	for (std::size_t i=0; i<count; i++) {
+		const SourcePos pos = in.pos();
+		if (in.byte() != UppercaseMod) return Unexpected(BinaryMalformed, pos);
+		result.push_back(Mod::Uppercase {});
+	}
+	return result;
+}
+
+auto BinaryFormat::Cursor::byte() -> uint8_t {
+	if (at == end) return truncated = true, 0;
+	return str[at++];
+}
+
+auto BinaryFormat::Cursor::varint() -> uint64_t {
+	uint64_t result = 0;
+	for (int shift=0; shift<64; shift+=7) {
+		const uint8_t b = byte();
+		result |= uint64_t(b & 0x7f) << shift;
+		if (!(b & 0x80)) return result;
+	}
+	// (Too long to be anything written, so nothing more is read.)
+	truncated = true;
+	return 0;
+}
+
+auto BinaryFormat::Cursor::float64() -> double {
+	if (left() < 8) return at = end, truncated = true, 0.0;
+	uint64_t bits = 0;
+	for (int i=0; i<64; i+=8) bits |= uint64_t(uint8_t(str[at++])) << i;
+	return std::bit_cast<double>(bits);
+}
+
+auto BinaryFormat::Cursor::bytes(std::size_t n) -> std::string_view {
+	if (left() < n) return at = end, truncated = true, std::string_view {};
+	return str.substr(std::exchange(at, at+n), n);
+}
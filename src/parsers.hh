@@ -2,42 +2,124 @@
 #include "parserBase.hh"
 #include "types.hh"
 #include "math.hh"
+#include "threadPool.hh"
+#include "mappedFile.hh"
+#include <array>
+#include <climits>
 #include <iostream>
 #include <vector>
 #include <variant>
+#include <optional>
+#include <string>
 
 class RawFormat : public ParserBase {
 public:
-	// Alternatively I could use an istream& instead of a string_view.
+	class Reader;
+
 	static auto parse(std::string_view) -> Expected<FlatSketch>;
+	static auto parse(std::istream&) -> Expected<FlatSketch>;
 	static void print(std::ostream&, const FlatSketch&);
 
 private:
-	static auto tokenize(std::string_view)
-	-> std::vector<Token>;
+	static auto strokeParse(Token) -> Expected<Atom::FlatStroke>;
+};
+
+// Pulls strokes (each a run of non-whitespace) out of a raw sketch one
+// at a time, reading a chunk of the stream at a time, same as
+// SketchFormat::Reader does for elements.
+class RawFormat::Reader {
+	std::istream* stream = nullptr;
+	std::string buffer {};
+	std::string_view input {}; // From the next stroke onward.
+	SourcePos pos {1,1};
+
+	auto more() -> bool;
 
-	static auto rawParse(TokenSpan)
-	-> Expected<FlatSketch>;
+public:
+	static constexpr std::size_t ChunkSize = 1 << 16;
+
+	Reader(std::istream&);
+	Reader(std::string_view);
+	// The next stroke, or nothing once there aren't any more.
+	auto next() -> Expected<std::optional<Atom::FlatStroke>>;
 };
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 class SketchFormat : public ParserBase {
 public:
+	class Reader;
+	class Index; // (See lazyIndex.hh.)
+
 	static auto parse(std::string_view) -> Expected<Sketch>;
+	static auto parse(std::istream&) -> Expected<Sketch>;
+	// Same result, but with runs of elements parsed on the pool,
+	// (once a quick scan's found where each one starts).
+	static auto parse(std::string_view, ThreadPool&) -> Expected<Sketch>;
+	// Straight out of a mapped file, which the sketch then holds on to.
+	static auto parse(std::shared_ptr<const MappedFile>) -> Expected<Sketch>;
+	static auto parse(std::shared_ptr<const MappedFile>, ThreadPool&) -> Expected<Sketch>;
+	// Where each element is and what its modifiers are, with atoms
+	// left undecoded until asked for. Only errors outside of the atoms
+	// are found this early, (the rest turn up decoding them).
+	static auto index(std::string_view) -> Expected<Index>;
+	static auto index(std::shared_ptr<const MappedFile>) -> Expected<Index>;
+
+	// What scan() finds in a sketch.
+	struct Summary {
+		using Point = Atom::FlatStroke::Point;
+		std::size_t elements = 0;
+		// How many of each type, (indexed like Element's alternatives,
+		// with Raw counting as Data, since that's what it parses to).
+		std::array<std::size_t, std::variant_size_v<Element>> types {};
+		std::size_t strokes = 0, points = 0;
+		// Inclusive box of every point before modifiers, (lo > hi when
+		// there aren't any).
+		std::pair<Point,Point> bounds {{INT_MAX, INT_MAX}, {INT_MIN, INT_MIN}};
+	};
+	// Whether parse() would succeed, (and if not, the same error it'd
+	// give), plus a summary, without building the sketch. Atoms are
+	// checked and counted where they sit in the text, never decoded into
+	// vectors, and anything unusual is just parsed, (see scan.cc).
+	static auto scan(std::string_view) -> Expected<Summary>;
 	static void print(std::ostream&, const Sketch&);
+	// Appended to the string, (with no stream in between).
+	static void print(std::string&, const Sketch&);
 
 private:
-	static auto tokenize(std::string_view)
-	-> Expected<std::vector<Token>>;
+	enum TokenizerState {
+		LineStart, Comment, Space, End,
+		NumOrType, String, StringEnd, Operator,
+	};
+	static auto tokenizerStep(TokenizerState, char, int& parenCount)
+	-> TokenizerState;
+	// Tokens up to and including the first ',' or ';', pushed onto
+	// the end of tokens, giving how many chars that took, (or npos if
+	// neither turned up). A slice of a file can be tokenized on its own,
+	// given the position it starts at, (which gets moved along), and the
+	// state the tokenizer was in just before it.
+	static auto tokenize(
+		std::string_view,
+		std::vector<Token>& tokens,
+		SourcePos& pos,
+		TokenizerState = LineStart
+	) -> Expected<std::size_t>;
+
+	// Where each top-level element begins, (the first at 0, then one
+	// past each ','), stopping at the ';'.
+	struct ElementStart { std::size_t offset; SourcePos pos; };
+	static auto elementStarts(std::string_view) -> std::vector<ElementStart>;
 
 	static auto isStringLiteral(const Token) -> bool;
-	static auto removeTicks(std::string_view) -> Expected<std::string>;
+	// Ticks can go between any digits of a stroke, (just not at
+	// either end, or two in a row), and get skipped when decoding.
+	static constexpr char Tick = '\'';
+	static auto ticksValid(std::string_view) -> bool;
 
 	template <typename T, typename... Args>
 	using Parser = auto (TokenSpan, Args...) -> Expected<T>;
 
-	static Parser  <Sketch>                         sketchParse;
+	/*         Reader::next() */
 	static Parser/*└─*/<Element>                    elementParse;
 	static Parser/*    │ */<Element>                typeBrushParse;
 	static Parser/*    │ */<Element>                typePencilParse;
@@ -62,10 +144,95 @@ private:
 	template <typename E, std::size_t N, typename Atom_t>
 	static Parser<Element, Parser<Atom_t>&> parseStroke;
 
+	// A stroke element's atoms, (from just after its '['), checked like
+	// parseStroke() would, with N tokens to an atom whose last is Nums
+	// tuples. Counted into the summary rather than kept, giving how many
+	// tokens there were and how far it is to the ']', or nothing if
+	// anything else turns up first.
+	template <std::size_t N, typename... Nums>
+	static auto atomsScan(std::string_view, Summary&)
+	-> std::optional<std::pair<std::size_t, std::size_t>>;
+	// Where the element at offset has its '[', if that comes before its
+	// delimiter or any string, (so the search stays inside the element).
+	static auto bracketScan(std::string_view, std::size_t offset)
+	-> std::optional<std::size_t>;
+
 public:
 	static void printTokens(std::string_view);
 };
 
+// Pulls elements out of a sketch one at a time, as soon as each one's
+// last token has been read, so only the current element (and a chunk
+// of input) is ever held. Errors point at the same positions parse()
+// has always given, though an element's error now comes up before
+// finding out the file never closes a string or is missing its ';'.
+class SketchFormat::Reader {
+	std::istream* stream = nullptr;
+	std::string buffer {};     // Read from the stream, (if there is one).
+	std::string_view input {}; // From the current element onward.
+	std::vector<Token> tokens {}; // The current element's, (reused).
+
+	// Where the current element starts.
+	TokenizerState startState = LineStart;
+	SourcePos startPos {1,1};
+	std::optional<SourcePos> lastComma {};
+	bool first = true, done = false;
+
+	auto more() -> bool;
+
+public:
+	static constexpr std::size_t ChunkSize = 1 << 16;
+
+	Reader(std::istream&);
+	Reader(std::string_view);
+	// Partway into a file, just after the ',' at pos.
+	Reader(std::string_view rest, SourcePos pos);
+	// The next element, or nothing once the ';' has been reached.
+	auto next() -> Expected<std::optional<Element>>;
+};
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+// Sketches as bytes, for archiving and interchange, (the layout's laid
+// out in parsers.cc). Gives back exactly the Sketch that was printed,
+// except that Raw elements were only ever Data to begin with. Errors
+// point at the byte they were found at, as a column of row 1.
+class BinaryFormat : public ParserBase {
+public:
+	static constexpr std::string_view Magic = "hscb";
+	static constexpr uint8_t Version = 1;
+
+	// The type bytes of elements and modifiers.
+	enum Type : uint8_t { BrushType, PencilType, DataType, MarkerType };
+	enum StrokeModType : uint8_t { AffineMod, ArrayMod };
+	enum MarkerModType : uint8_t { UppercaseMod };
+
+	static auto parse(std::string_view) -> Expected<Sketch>;
+	static void print(std::ostream&, const Sketch&);
+
+private:
+	// Reads the input up to end, giving zeros (and remembering it) once
+	// that runs out, so errors only need checking now and then.
+	struct Cursor {
+		std::string_view str;
+		std::size_t at, end;
+		bool truncated = false;
+
+		auto left() const -> std::size_t { return end - at; }
+		auto pos() const -> SourcePos { return {1, at+1}; }
+		auto byte() -> uint8_t;
+		auto varint() -> uint64_t;
+		auto float64() -> double;
+		auto bytes(std::size_t) -> std::string_view;
+	};
+
+	static auto elementParse(Type, Cursor&) -> Expected<Element>;
+	template <typename Element_t>
+	static auto strokesParse(Cursor&) -> Expected<Element>;
+	static auto modsStrokeParse(Cursor&) -> Expected<StrokeModifiers>;
+	static auto modsMarkerParse(Cursor&) -> Expected<MarkerModifiers>;
+};
+
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 template <typename Element_t, std::size_t AtomLen, typename Atom_t>
@@ -81,7 +248,7 @@ auto SketchFormat::parseStroke(
 	auto contents = parenParse(tokens, it);
 	if (!contents) return Unexpected(contents.error(), *it);
 
-	std::vector<Atom_t> strokes {};
+	decltype(Element_t::atoms) strokes {};
 	strokes.reserve(contents->size());
 
 	if (tokens.size() % AtomLen) return Unexpected(ElementBrushSize);
@@ -97,5 +264,5 @@ auto SketchFormat::parseStroke(
 	);
 	if (!modifiers) return Unexpected(modifiers.error());
 
-	return Element_t {strokes, *modifiers};
+	return Element_t {std::move(strokes), *modifiers};
 }
\ No newline at end of file
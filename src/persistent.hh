@@ -0,0 +1,132 @@
+#pragma once
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+// A vector whose copies share everything they have in common. It's a
+// 32-way trie of chunks, plus a loose chunk at the end which pushes go
+// into, so a copy costs O(1), and push_back or editing the last element
+// only copies the O(log n) path down to it. Anything nobody else holds
+// gets changed in place. (Copies on one thread at a time, please.)
+template <typename T>
+class PersistentVector {
+	static constexpr std::size_t Bits = 5, Width = 1 << Bits, Mask = Width-1;
+
+	struct Node {
+		std::vector<std::shared_ptr<Node>> children; // Branches.
+		std::vector<std::shared_ptr<T>> items;       // Leaves.
+	};
+	using NodePtr = std::shared_ptr<Node>;
+
+	NodePtr root = std::make_shared<Node>();
+	NodePtr tail = std::make_shared<Node>();
+	std::size_t count = 0;
+	std::size_t shift = Bits;
+
+	// Anything shared gets copied before it's changed.
+	template <typename P>
+	static auto own(P& p) -> P& {
+		if (p.use_count() > 1) p = std::make_shared<typename P::element_type>(*p);
+		return p;
+	}
+
+	auto tailOffset() const -> std::size_t {
+		return count < Width ? 0 : ((count-1) >> Bits) << Bits;
+	}
+
+	auto leafFor(std::size_t i) const -> const Node* {
+		if (i >= tailOffset()) return tail.get();
+		const Node* node = root.get();
+		for (std::size_t level = shift; level > 0; level -= Bits) {
+			node = node->children[(i >> level) & Mask].get();
+		}
+		return node;
+	}
+
+	static auto newPath(std::size_t level, NodePtr leaf) -> NodePtr {
+		if (level == 0) return leaf;
+		auto node = std::make_shared<Node>();
+		node->children.push_back(newPath(level - Bits, std::move(leaf)));
+		return node;
+	}
+
+	// (By reference, so a node nobody else holds isn't copied.)
+	void pushTail(std::size_t level, NodePtr& parent, NodePtr leaf) {
+		own(parent);
+		const std::size_t i = ((count-1) >> level) & Mask;
+		auto& children = parent->children;
+		if (level == Bits) {
+			children.push_back(std::move(leaf));
+		}
+		else if (i < children.size()) {
+			pushTail(level - Bits, children[i], std::move(leaf));
+		}
+		else {
+			children.push_back(newPath(level - Bits, std::move(leaf)));
+		}
+	}
+
+public:
+	class Iterator {
+		const PersistentVector* v = nullptr;
+		std::size_t i = 0;
+		const Node* leaf = nullptr;
+	public:
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+
+		Iterator() = default;
+		Iterator(const PersistentVector* v, std::size_t i)
+		: v{v}, i{i}, leaf{i < v->size() ? v->leafFor(i) : nullptr} {}
+
+		auto operator*() const -> const T& { return *leaf->items[i & Mask]; }
+		auto operator->() const -> const T* { return &**this; }
+		auto operator++() -> Iterator& {
+			// Only look the leaf up again when crossing into the next.
+			if ((++i & Mask) == 0) leaf = i < v->size() ? v->leafFor(i) : nullptr;
+			return *this;
+		}
+		auto operator++(int) -> Iterator { auto old = *this; ++*this; return old; }
+		bool operator==(const Iterator& other) const { return i == other.i; }
+	};
+
+	PersistentVector() {}
+	PersistentVector(std::initializer_list<T> list) { for (const T& x : list) push_back(x); }
+	PersistentVector(const std::vector<T>& v) { for (const T& x : v) push_back(x); }
+
+	auto size() const -> std::size_t { return count; }
+	bool empty() const { return count == 0; }
+	auto operator[](std::size_t i) const -> const T& { return *leafFor(i)->items[i & Mask]; }
+	auto back() const -> const T& { return *tail->items.back(); }
+	// The i'th element's own storage, shared by every copy of the
+	// vector that hasn't edited it, (so telling copies apart is cheap).
+	auto shared(std::size_t i) const -> std::shared_ptr<const T> { return leafFor(i)->items[i & Mask]; }
+	auto begin() const -> Iterator { return {this, 0}; }
+	auto end() const -> Iterator { return {this, count}; }
+
+	void push_back(T x) {
+		if (count - tailOffset() == Width) {
+			// The tail's full, so it joins the trie, (which grows
+			// a level once the root runs out of room).
+			if ((count >> Bits) > (std::size_t(1) << shift)) {
+				auto grown = std::make_shared<Node>();
+				grown->children = {root, newPath(shift, tail)};
+				root = std::move(grown);
+				shift += Bits;
+			}
+			else {
+				pushTail(shift, root, tail);
+			}
+			tail = std::make_shared<Node>();
+		}
+		own(tail)->items.push_back(std::make_shared<T>(std::move(x)));
+		count++;
+	}
+
+	// The last element, copied first if any other vector shares it.
+	auto editBack() -> T& {
+		return *own(own(tail)->items.back());
+	}
+};
@@ -2,25 +2,168 @@
 #include "graphics.hh"
 #include "util.hh"
 #include <algorithm>
+#include <array>
+#include <bit>
+
+namespace
+{
+	// Blend for formats whose color channels are whole bytes, which
+	// covers every 32-bit surface SDL hands out. The strokes are all
+	// grey, so it doesn't matter which byte holds which channel.
+	template <uint32_t ColorMask>
+	struct PackedBlend {
+		uint32_t alpha;
+
+		uint32_t operator()(uint32_t pixel, uint8_t c) const {
+			uint32_t result = alpha;
+			for (unsigned shift=0; shift<32; shift+=8) {
+				if (!(ColorMask >> shift & 0xFF)) continue;
+				uint32_t old = pixel >> shift & 0xFF;
+				result |= std::min<uint32_t>(old, c) << shift;
+			}
+			return result;
+		}
+	};
+
+	// Anything else gets decoded and re-encoded channel by
+	// channel, (scaled to and from 8 bits like SDL would).
+	struct MaskedBlend {
+		struct Channel { uint32_t mask; unsigned shift; uint64_t max; };
+		std::array<Channel,3> channels;
+		uint32_t alpha;
+
+		MaskedBlend(PixelFormat f) : alpha{f.Amask} {
+			for (std::size_t i=0; uint32_t mask : {f.Rmask, f.Gmask, f.Bmask}) {
+				unsigned shift = std::countr_zero(mask) & 31;
+				channels[i++] = {mask, shift, mask >> shift};
+			}
+		}
+
+		uint32_t operator()(uint32_t pixel, uint8_t c) const {
+			uint32_t result = alpha;
+			for (const auto [mask, shift, max] : channels) {
+				if (max == 0) continue;
+				uint64_t old = ((pixel & mask) >> shift) * 255 / max;
+				uint64_t blended = std::min<uint64_t>(old, c);
+				result |= uint32_t((blended * max + 127) / 255) << shift;
+			}
+			return result;
+		}
+	};
+
+	using Point = Atom::FlatStroke::Point;
+
+	Vec2 toVec2(Point p) { return {Real(p.x), Real(p.y)}; }
+
+	// Calls f(p,q) on each segment of every instance which could reach
+	// into clip, transforming the points along the way.
+	template <typename F>
+	void forEachSegment(
+		std::span<const SharedInstances> elements,
+		Rect clip, F&& f
+	) {
+		for (const SharedInstances& e : elements)
+		for (std::size_t i=0; i<e->size(); i++) {
+			auto [lo, hi] = e->bounds(i);
+			if (lo.x > hi.x) continue;
+			if (isEmpty(intersect(clip, {lo.x-2, lo.y-2, hi.x+3, hi.y+3}))) continue;
+
+			for (const Atom::FlatStroke& s : e->strokes) {
+				if (s.points.size() < 2) continue;
+				Point p = e->apply(i, s.points[0]);
+				for (std::size_t k=1; k<s.points.size(); k++) {
+					Point q = e->apply(i, s.points[k]);
+					f(p, q);
+					p = q;
+				}
+			}
+		}
+	}
+
+	// Turns streamed points back into segments for f, and skips
+	// instances that can't reach into clip.
+	template <typename F>
+	class SegmentsOf final : public StrokeVisitor {
+		Rect clip; F& f;
+		Point last {0,0};
+		bool started = false;
+
+	public:
+		SegmentsOf(Rect clip, F& f) : clip{clip}, f{f} {}
+
+		bool wants(Point lo, Point hi) override {
+			return !isEmpty(intersect(clip, {lo.x-2, lo.y-2, hi.x+3, hi.y+3}));
+		}
+		void beginStroke() override { started = false; }
+		void point(Point p) override {
+			if (started) f(last, p);
+			last = p, started = true;
+		}
+	};
+}
 
 Renderer::Renderer(
 	std::span<uint32_t> output,
 	unsigned W, unsigned H,
-	std::function<uint32_t(Col3)> map,
-	std::function<Col3(uint32_t)> get
+	PixelFormat format
 )
-: pixels{output}, W{W}, H{H}
-, MapRGB{map}, GetRGB{get} {}
+: pixels{output}, W{W}, H{H}, format{format}
+, coverage(W + SDFlineCoverageBlock) {
+	auto isByte = [](uint32_t mask) {
+		return std::popcount(mask) == 8
+		&&     std::countr_zero(mask) % 8 == 0;
+	};
+
+	const uint32_t color = format.Rmask | format.Gmask | format.Bmask;
+	layout = !(isByte(format.Rmask)
+	&&         isByte(format.Gmask)
+	&&         isByte(format.Bmask)) ? Layout::Masked
+	: color == 0x00FFFFFF ? Layout::Low24
+	: color == 0xFFFFFF00 ? Layout::High24
+	: /* default:      */   Layout::Masked;
+}
+
+template <typename F>
+void Renderer::withBlend(F&& f) const {
+	switch (layout) {
+	case Layout::Low24:
+		return f(PackedBlend<0x00FFFFFF> {format.Amask});
+	case Layout::High24:
+		return f(PackedBlend<0xFFFFFF00> {format.Amask});
+	case Layout::Masked:
+		return f(MaskedBlend {format});
+	}
+}
 
 /* ~~ Drawing Functions ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+auto Renderer::bounds(const Atom::FlatStroke& s) -> Rect {
+	if (s.points.size() < 2) return {0,0,0,0};
+	auto [xMin, xMax] = ranges::minmax(s.points, {}, &Atom::FlatStroke::Point::x);
+	auto [yMin, yMax] = ranges::minmax(s.points, {}, &Atom::FlatStroke::Point::y);
+	// Same 2px margin drawLine uses.
+	return {xMin.x-2, yMin.y-2, xMax.x+3, yMax.y+3};
+}
+
+auto Renderer::screen() const -> Rect {
+	return {0, 0, int(W), int(H)};
+}
+
 void Renderer::displayRaw(std::span<const Atom::FlatStroke> strokes) {
+	displayRaw(strokes, screen());
+}
+
+void Renderer::displayRaw(
+	std::span<const Atom::FlatStroke> strokes,
+	Rect clip
+) {
+	clip = intersect(clip, screen());
+	if (isEmpty(clip)) return;
+
+	withBlend([&](const auto& blend) {
 	for (const Atom::FlatStroke& s : strokes) {
 		if (s.points.size() < 2) continue;
-
-		auto toVec2 = [](Atom::FlatStroke::Point p) {
-			return Vec2 {Real(p.x), Real(p.y)};
-		};
+		if (clip != screen() && isEmpty(intersect(clip, bounds(s)))) continue;
 
 		// ranges::for_each(
 		// 	s.points
@@ -31,45 +174,180 @@ void Renderer::displayRaw(std::span<const Atom::FlatStroke> strokes) {
 		for (std::size_t i=0; i<s.points.size()-1; i++) {
 			drawLine(
 				toVec2(s.points[i+0]),
-				toVec2(s.points[i+1])
+				toVec2(s.points[i+1]),
+				clip, blend, coverage
 			);
 		}
 	}
+	});
+}
+
+void Renderer::displayRaw(
+	std::span<const Atom::FlatStroke> strokes,
+	Rect clip, ThreadPool& pool
+) {
+	drawTiled(intersect(clip, screen()), pool, [&](auto&& f) {
+		for (const Atom::FlatStroke& s : strokes)
+		for (std::size_t i=0; i+1<s.points.size(); i++) {
+			f(s.points[i], s.points[i+1]);
+		}
+	});
+}
+
+void Renderer::display(
+	std::span<const SharedInstances> elements,
+	Rect clip
+) {
+	clip = intersect(clip, screen());
+	if (isEmpty(clip)) return;
+
+	withBlend([&](const auto& blend) {
+		forEachSegment(elements, clip, [&](Point p, Point q) {
+			drawLine(toVec2(p), toVec2(q), clip, blend, coverage);
+		});
+	});
+}
+
+void Renderer::display(
+	std::span<const SharedInstances> elements,
+	Rect clip, ThreadPool& pool
+) {
+	clip = intersect(clip, screen());
+	drawTiled(clip, pool, [&](auto&& f) {
+		forEachSegment(elements, clip, f);
+	});
+}
+
+void Renderer::display(const Sketch& sketch, Rect clip) {
+	clip = intersect(clip, screen());
+	if (isEmpty(clip)) return;
+
+	withBlend([&](const auto& blend) {
+		auto draw = [&](Point p, Point q) {
+			drawLine(toVec2(p), toVec2(q), clip, blend, coverage);
+		};
+		SegmentsOf segments {clip, draw};
+		sketch.visit(segments);
+	});
+}
+
+void Renderer::display(const Sketch& sketch, Rect clip, ThreadPool& pool) {
+	clip = intersect(clip, screen());
+	drawTiled(clip, pool, [&](auto&& f) {
+		SegmentsOf segments {clip, f};
+		sketch.visit(segments);
+	});
+}
+
+void Renderer::display(const Strokes& strokes, Rect clip) {
+	clip = intersect(clip, screen());
+	if (isEmpty(clip)) return;
+
+	withBlend([&](const auto& blend) {
+		auto draw = [&](Point p, Point q) {
+			drawLine(toVec2(p), toVec2(q), clip, blend, coverage);
+		};
+		SegmentsOf segments {clip, draw};
+		strokes(segments);
+	});
+}
+
+void Renderer::display(const Strokes& strokes, Rect clip, ThreadPool& pool) {
+	clip = intersect(clip, screen());
+	drawTiled(clip, pool, [&](auto&& f) {
+		SegmentsOf segments {clip, f};
+		strokes(segments);
+	});
+}
+
+template <typename Segments>
+void Renderer::drawTiled(Rect clip, ThreadPool& pool, Segments&& segments) {
+	if (isEmpty(clip)) return;
+
+	const int tx0 = clip.x0 / Tile, tx1 = (clip.x1-1) / Tile + 1;
+	const int ty0 = clip.y0 / Tile, ty1 = (clip.y1-1) / Tile + 1;
+	const int cols = tx1 - tx0;
+	bins.resize(cols * (ty1 - ty0));
+	for (auto& bin : bins) bin.clear();
+
+	segments([&](Point p, Point q) {
+		Rect box = intersect(clip, {
+			std::min(p.x, q.x) - 2, std::min(p.y, q.y) - 2,
+			std::max(p.x, q.x) + 3, std::max(p.y, q.y) + 3,
+		});
+		if (isEmpty(box)) return;
+
+		const Segment seg {toVec2(p), toVec2(q)};
+		for (int ty = box.y0/Tile; ty <= (box.y1-1)/Tile; ty++)
+		for (int tx = box.x0/Tile; tx <= (box.x1-1)/Tile; tx++) {
+			bins[(ty-ty0)*cols + (tx-tx0)].push_back(seg);
+		}
+	});
+
+	withBlend([&](const auto& blend) {
+		pool.parallelFor(bins.size(), [&](std::size_t i) {
+			const int tx = tx0 + i % cols, ty = ty0 + i / cols;
+			const Rect tile = intersect(clip, {
+				tx*Tile, ty*Tile, (tx+1)*Tile, (ty+1)*Tile,
+			});
+
+			std::array<uint8_t, Tile + SDFlineCoverageBlock> scratch;
+			for (const Segment& seg : bins[i]) {
+				drawLine(seg.a, seg.b, tile, blend, scratch);
+			}
+		});
+	});
 }
 
 void Renderer::clear() {
-	for (std::size_t i=0; i<W*H; i++) {
-		pixels[i] = MapRGB({255,255,255});
+	// White is every channel at its maximum, (and opaque).
+	ranges::fill(pixels.first(W*H),
+		format.Rmask | format.Gmask | format.Bmask | format.Amask
+	);
+}
+
+void Renderer::clear(Rect r) {
+	r = intersect(r, screen());
+	if (isEmpty(r)) return;
+
+	const uint32_t white =
+		format.Rmask | format.Gmask | format.Bmask | format.Amask;
+	for (int y=r.y0; y<r.y1; y++) {
+		ranges::fill(pixels.subspan(y*W + r.x0, r.x1 - r.x0), white);
 	}
 }
 
-// TODO: more efficient line draw function
-void Renderer::drawLine(Vec2 a, Vec2 b) {
+template <typename Blend>
+void Renderer::drawLine(
+	Vec2 a, Vec2 b, Rect clip, const Blend& blend,
+	std::span<uint8_t> coverage
+) {
 	auto [xMin, xMax] = std::minmax(a.x, b.x);
 	auto [yMin, yMax] = std::minmax(a.y, b.y);
-	const Real x0 = max(  0, xMin-2);
-	const Real y0 = max(  0, yMin-2);
-	const Real x1 = min(W-1, xMax+2);
-	const Real y1 = min(H-1, yMax+2);
+	const Real x0 = max(clip.x0  , xMin-2);
+	const Real y0 = max(clip.y0  , yMin-2);
+	const Real x1 = min(clip.x1-1, xMax+2);
+	const Real y1 = min(clip.y1-1, yMax+2);
 
-	const Vec2 av = {a.x, a.y};
-	const Vec2 bv = {b.x, b.y};
+	const LineSDF line {a, b};
 
-	Vec2 xy;
 	for (Real y=y0; y<=y1; y+=1) {
-	for (Real x=x0; x<=x1; x+=1) {
-		xy = Vec2 {x + 0.5, y + 0.5};
-		uint8_t c = 255*clamp(
-			SDFline(xy, av, bv) - 1,
-			0, 1
-		);
-		auto& pixel = pixels[y*W + x];
-		Col3 cOld = GetRGB(pixel);
+		// Only visit the pixels whose centers land inside the
+		// capsule. Everything further than 2px out stays at
+		// 255, which the min-blend below would ignore anyway.
+		// (Padded by a pixel to absorb any rounding error.)
+		const Interval span = SDFlineRow(y + 0.5, a, b, 2);
+		const Real xa = max(x0, std::ceil (span.lo - 0.5) - 1);
+		const Real xb = min(x1, std::floor(span.hi - 0.5) + 1);
+		if (xa > xb) continue;
+
+		const std::size_t n = xb - xa + 1;
+		SDFlineCoverage(coverage.data(), n, xa + 0.5, y + 0.5, line);
+
 		// TODO: basic blending modes
-		pixel = MapRGB({
-			(cOld.r < c) ? cOld.r : c,
-			(cOld.g < c) ? cOld.g : c,
-			(cOld.b < c) ? cOld.b : c,
-		});
-	} }
+		auto row = pixels.subspan(y*W + xa, n);
+		for (std::size_t i=0; i<n; i++) {
+			row[i] = blend(row[i], coverage[i]);
+		}
+	}
 }
\ No newline at end of file
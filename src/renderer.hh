@@ -1,28 +1,67 @@
 #pragma once
 #include "types.hh"
 #include "graphics.hh"
+#include "threadPool.hh"
 #include <functional>
 #include <span>
+#include <vector>
 
+// Channel masks of a 32-bit pixel format, (as in SDL_PixelFormat).
+struct PixelFormat { uint32_t Rmask, Gmask, Bmask, Amask; };
 
 class Renderer {
 	std::span<uint32_t> pixels;
 	const unsigned W = 800;
 	const unsigned H = 600;
-	std::function<uint32_t(Col3)> MapRGB;
-	std::function<Col3(uint32_t)> GetRGB;
+	PixelFormat format;
+	enum class Layout { Low24, High24, Masked } layout;
+	std::vector<uint8_t> coverage; // Scratch space for one row.
 
-	void drawLine(Vec2 a, Vec2 b);
+	// Segments sorted into square tiles, (reused frame to frame).
+	struct Segment { Vec2 a, b; };
+	static constexpr int Tile = 64;
+	std::vector<std::vector<Segment>> bins;
+
+	// Calls f with the blend function for our pixel layout,
+	// so the choice is made once and not once per pixel.
+	template <typename F> void withBlend(F&& f) const;
+	template <typename Segments>
+	void drawTiled(Rect clip, ThreadPool&, Segments&&);
+	template <typename Blend>
+	void drawLine(
+		Vec2 a, Vec2 b, Rect clip, const Blend&,
+		std::span<uint8_t> coverage
+	);
 
 public:
 	Renderer(
 		std::span<uint32_t> output,
 		unsigned W, unsigned H,
-		std::function<uint32_t(Col3)> map,
-		std::function<Col3(uint32_t)> get
+		PixelFormat format
 	);
 
+	// Every pixel the stroke could possibly touch.
+	static auto bounds(const Atom::FlatStroke&) -> Rect;
+	auto screen() const -> Rect;
+
 	void clear();
+	void clear(Rect);
 	void displayRaw(std::span<const Atom::FlatStroke>);
-	// void display(std::span<const Elements>);
-};
\ No newline at end of file
+	void displayRaw(std::span<const Atom::FlatStroke>, Rect clip);
+	// Same picture, but drawn a tile at a time on the pool. Blending
+	// is a min, so the order tiles and strokes land in won't matter.
+	void displayRaw(std::span<const Atom::FlatStroke>, Rect clip, ThreadPool&);
+	// Draws every instance straight off its element's strokes,
+	// skipping the ones whose bounds fall outside of clip.
+	void display(std::span<const SharedInstances>, Rect clip);
+	void display(std::span<const SharedInstances>, Rect clip, ThreadPool&);
+	// Streams the sketch's segments straight into the rasterizer,
+	// without flattening it first, (or allocating, once warmed up).
+	void display(const Sketch&, Rect clip);
+	void display(const Sketch&, Rect clip, ThreadPool&);
+	// Same again for anything else that streams its strokes into a
+	// visitor, (a lazily decoded SketchFormat::Index, say).
+	using Strokes = std::function<void(StrokeVisitor&)>;
+	void display(const Strokes&, Rect clip);
+	void display(const Strokes&, Rect clip, ThreadPool&);
+};
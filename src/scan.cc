@@ -0,0 +1,220 @@
+#include "parsers.hh"
+#include <algorithm>
+#include <array>
+#include <climits>
+
+// Validating a sketch, (for when all that's wanted is whether it's
+// well-formed and how big it is). Stroke elements are split up like
+// index() does, with the atoms between their brackets checked in place:
+// split on whitespace, tick marks checked, and base-36 tuples visited
+// one at a time, with nothing allocated per atom. Whatever doesn't fit
+// that, (Markers, strings, or anything with an error in it), is handed
+// to the Reader, so errors are exactly the ones parse() gives.
+
+namespace
+{
+	using Point = SketchFormat::Summary::Point;
+
+	void include(std::pair<Point,Point>& box, int x, int y) {
+		// (Point's constructor isn't inline, and this is per point.)
+		auto& [lo, hi] = box;
+		lo.x = std::min(lo.x, x), lo.y = std::min(lo.y, y);
+		hi.x = std::max(hi.x, x), hi.y = std::max(hi.y, y);
+	}
+
+	void add(SketchFormat::Summary& total, const SketchFormat::Summary& s) {
+		total.elements += s.elements;
+		for (std::size_t i=0; i<s.types.size(); i++) total.types[i] += s.types[i];
+		total.strokes += s.strokes;
+		total.points += s.points;
+		if (!s.points) return;
+		include(total.bounds, s.bounds.first.x, s.bounds.first.y);
+		include(total.bounds, s.bounds.second.x, s.bounds.second.y);
+	}
+
+	// The same counts for an element that's been parsed.
+	auto summarize(const Element& variant) -> SketchFormat::Summary {
+		SketchFormat::Summary result {};
+		result.elements = 1;
+		result.types[variant.index()] = 1;
+		std::visit([&]<typename T>(const T& elem) {
+			if constexpr (HoldsStrokeAtoms<T>) {
+				for (const StrokeAtoms::View s : elem.atoms) {
+					result.strokes++;
+					result.points += s.size();
+					for (std::size_t i=0; i<s.size(); i++) include(result.bounds, s.x[i], s.y[i]);
+				}
+			}
+			else if constexpr (HoldsFlatStrokeAtoms<T>) {
+				for (const Atom::FlatStroke& s : elem.atoms) {
+					result.strokes++;
+					result.points += s.points.size();
+					for (const auto p : s.points) include(result.bounds, p.x, p.y);
+				}
+			}
+		}, variant);
+		return result;
+	}
+}
+
+template <std::size_t N, typename... Nums>
+auto SketchFormat::atomsScan(std::string_view str, Summary& summary)
+-> std::optional<std::pair<std::size_t, std::size_t>> {
+	constexpr auto space = [] {
+		std::array<bool, 256> table {};
+		for (char c : " \t\n\r"sv) table[uint8_t(c)] = true;
+		return table;
+	} ();
+	// (Kept here rather than in the summary, so they can stay in registers.)
+	std::size_t count = 0, points = 0;
+	int loX = INT_MAX, loY = INT_MAX, hiX = INT_MIN, hiY = INT_MIN;
+	auto done = [&](std::size_t length) {
+		summary.points += points;
+		if (points) include(summary.bounds, loX, loY), include(summary.bounds, hiX, hiY);
+		return std::pair {count, length};
+	};
+
+	for (std::size_t i=0; i<str.size(); /**/) {
+		// (Comments only start right at the beginning of a line.)
+		if (str[i] == '%' && i > 0 && isNewline(str[i-1])) {
+			while (i < str.size() && !isNewline(str[i])) i++;
+			continue;
+		}
+		if (space[uint8_t(str[i])]) { i++; continue; }
+		if (str[i] == ']') return done(i);
+
+		// Brushes lead each stroke with its diameter.
+		if (count++ % N != N-1) {
+			std::size_t j = i;
+			while (j < str.size() && !space[uint8_t(str[j])] && str[j] != ']') j++;
+			if (!Base36::parse<2,unsigned>(str.substr(i, j-i))) return std::nullopt;
+			i = j;
+			continue;
+		}
+		const auto length = Base36::visitTuples<Nums...>(str.substr(i), Tick,
+			[&](auto x, auto y, auto...) {
+				points++;
+				loX = std::min(loX, int(*x)), loY = std::min(loY, int(*y));
+				hiX = std::max(hiX, int(*x)), hiY = std::max(hiY, int(*y));
+			}
+		);
+		// (It has to have stopped at the end of the token.)
+		if (!length) return std::nullopt;
+		i += *length;
+		if (i < str.size() && !space[uint8_t(str[i])] && str[i] != ']') return std::nullopt;
+		summary.strokes++;
+	}
+	return std::nullopt;
+}
+
+auto SketchFormat::bracketScan(std::string_view str, std::size_t offset)
+-> std::optional<std::size_t> {
+	// Same as Index::payloadOf(), just not looking for the ']'. Anything
+	// without a '[' goes to the Reader anyway, and stopping here keeps a
+	// run of Markers from each searching the file ahead for one.
+	constexpr auto special = [] {
+		std::array<bool, 256> table {};
+		for (char c : "\n\r%[]();,"sv) table[uint8_t(c)] = true;
+		return table;
+	} ();
+
+	bool comment = false;
+	for (std::size_t i=offset; i<str.size(); i++) {
+		const char c = str[i];
+		if (!special[uint8_t(c)]) continue;
+		if (comment) {
+			if (isNewline(c)) comment = false;
+			continue;
+		}
+		if (c == '%' && (i == 0 || isNewline(str[i-1]))) comment = true;
+		if (c == '[') return i;
+		if (Util::isAny(c, "](),;")) return std::nullopt;
+	}
+	return std::nullopt;
+}
+
+auto SketchFormat::scan(std::string_view str)
+-> Expected<Summary> {
+	using S3 = Base36::Number_t<3,  signed>;
+	using U2 = Base36::Number_t<2,unsigned>;
+	Summary result {};
+	std::vector<Token> tokens {};
+
+	// Where an element starts, (which only matters for errors).
+	auto posAt = [&](std::size_t offset) {
+		const auto before = str.substr(0, offset);
+		SourcePos pos {1,1};
+		if (const auto newline = before.rfind('\n'); newline != before.npos) {
+			pos.row += std::ranges::count(before, '\n');
+			pos.col = before.size()-1 - newline;
+		}
+		else pos.col += before.size();
+		return pos;
+	};
+
+	// Each element in turn, up to the one ending in ';', each one
+	// starting where the delimiter of the one before it was found.
+	for (std::size_t offset = 0; /**/; /**/) {
+		const TokenizerState state = offset == 0 ? LineStart : Space;
+
+		// Split like index() does, (type and '[', atoms, then the ']',
+		// modifiers and delimiter), and check every part parses.
+		auto quick = [&] -> std::optional<Summary> {
+			const auto bracket = bracketScan(str, offset);
+			if (!bracket) return std::nullopt;
+			const std::size_t open = *bracket;
+
+			tokens.clear();
+			SourcePos at {}; // (Positions only matter for errors.)
+			auto head = tokenize(str.substr(offset, open+1 - offset), tokens, at, state);
+			if (!head || *head != str.npos || tokens.size() != 2) return std::nullopt;
+			const Token type = tokens[0];
+
+			Summary counted {};
+			counted.elements = 1;
+			const auto atoms = str.substr(open+1);
+			std::optional<std::pair<std::size_t, std::size_t>> scanned {};
+			if      (type == Token {"Brush" }) scanned = atomsScan<2, S3, S3, U2>(atoms, counted), counted.types[0]++;
+			else if (type == Token {"Pencil"}) scanned = atomsScan<1, S3, S3>(atoms, counted), counted.types[1]++;
+			else if (type == Token {"Data"  }) scanned = atomsScan<1, S3, S3>(atoms, counted), counted.types[2]++;
+			else if (type == Token {"Raw"   }) scanned = atomsScan<1, U2, U2>(atoms, counted), counted.types[2]++;
+			if (!scanned) return std::nullopt;
+			const auto [count, length] = *scanned;
+			const std::size_t close = open+1 + length;
+
+			tokens.clear();
+			auto tail = tokenize(str.substr(close), tokens, at, Space);
+			if (!tail || *tail == std::string_view::npos) return std::nullopt;
+			// (Parsing checks the brush's count against every token after
+			// its type, brackets and modifiers too.)
+			if (type == Token {"Brush"} && (count % 2 || (count + tokens.size()) % 2)) {
+				return std::nullopt;
+			}
+			if (!modsStrokeParse(TokenSpan {tokens}.subspan(1, tokens.size()-2))) {
+				return std::nullopt;
+			}
+			offset = close + *tail;
+			return counted;
+		} ();
+
+		if (quick) add(result, *quick);
+		else {
+			auto parsed = [&](SourcePos pos) {
+				Reader reader = offset == 0 ? Reader {str} : Reader {str.substr(offset), pos};
+				return reader.next();
+			};
+			auto element = parsed({});
+			// (Again from where it really is, for the error's position.)
+			if (!element) return Unexpected(parsed(posAt(offset)).error());
+			if (!*element) break; // (A lone ';'.)
+			add(result, summarize(**element));
+
+			// It parsed, so this finds its delimiter.
+			tokens.clear();
+			SourcePos at {};
+			offset += *tokenize(str.substr(offset), tokens, at, state);
+		}
+		if (tokens.back().string == ";") break;
+	}
+	return result;
+}
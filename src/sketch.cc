@@ -2,21 +2,30 @@
 #include "util.hh"
 #include <vector>
 #include <span>
+#include <bit>
 
 namespace
 {
 	using namespace Atom;
 
-	auto renderStroke(const Stroke s) {
+	// Either kind of stroke's points, (ignoring pressure ... for now).
+	template <typename F>
+	void forEachPoint(const FlatStroke& s, F&& f) {
+		for (FlatStroke::Point p : s.points) f(p);
+	}
+	template <typename F>
+	void forEachPoint(StrokeAtoms::View s, F&& f) {
+		for (std::size_t i=0; i<s.size(); i++) f(FlatStroke::Point {s.x[i], s.y[i]});
+	}
+
+	auto renderStroke(StrokeAtoms::View s) {
 		FlatStroke result {};
-		for (const auto& p : s.points) {
-			// Ignore p.pressure ... (for now).
-			result.points.emplace_back(p.x, p.y);
-		}
+		result.points.reserve(s.size());
+		forEachPoint(s, [&](FlatStroke::Point p) { result.points.push_back(p); });
 		return result;
 	}
 
-	auto renderStrokes(std::span<const Stroke> strokes) {
+	auto renderStrokes(const StrokeAtoms& strokes) {
 		return strokes
 			| views::transform(renderStroke)
 			| ranges::to<std::vector>();
@@ -43,29 +52,352 @@ namespace
 
 /* ~~ Main "Flatten" Function ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-auto Sketch::render() const -> FlatSketch {
-	FlatSketch result {};
+namespace
+{
+	// Modifiers become stages of instances, rather than
+	// being applied to copies of the strokes.
+	auto stagesOf(const StrokeModifiers& modifiers) {
+		std::vector<FlatInstances::Stage> stages {};
+		for (const auto& variant : strokeModsReduce(modifiers)) {
+			stages.push_back(std::visit(Util::Overloaded {
+				[](const Mod::Affine& a) { return FlatInstances::Stage {a}; },
+				[](const Mod::Array& a) { return a.powers(); },
+			}, variant));
+		}
+		return stages;
+	}
+
+	auto flatten(const Element& variant) -> FlatInstances {
+		return std::visit([&]<typename T>(const T& elem) {
+			if constexpr (HoldsStrokeMods<T>) {
+				auto stages = stagesOf(elem.modifiers);
+				if constexpr (HoldsFlatStrokeAtoms<T>) {
+					return FlatInstances {elem.atoms, std::move(stages)};
+				}
+				else {
+					return FlatInstances {renderStrokes(elem.atoms), std::move(stages)};
+				}
+			}
+			else return FlatInstances {};
+		}, variant);
+	}
+
 	auto append = [](auto& v, ranges::input_range auto&& r) {
 		ranges::copy(r, std::back_inserter(v));
 	};
+}
 
-	for (const auto& variant : elements) {
-		std::visit([&]<typename T>(const T& elem) {
-			if constexpr (HoldsStrokeMods<T>) {
-				auto mods = strokeModsReduce(elem.modifiers);
-				auto strokes = elem.atoms
-					| ranges::to<std::vector<Stroke>>();
-
-				for (const auto& variant : mods) {
-					std::visit([&strokes](const auto& mod) {
-						strokes = mod(strokes);
-					}, variant);
+auto Sketch::render() const -> FlatSketch {
+	struct Collect : StrokeVisitor {
+		FlatSketch result {};
+		void beginStroke() override { result.strokes.emplace_back(); }
+		void point(Point p) override { result.strokes.back().points.push_back(p); }
+	} collect {};
+
+	visit(collect);
+	return std::move(collect.result);
+}
+
+auto Sketch::render(FlattenCache& cache) const -> FlatSketch {
+	FlatSketch result {};
+	for (std::size_t i=0; i<elements.size(); i++) {
+		for (const auto& piece : cache.get(elements.shared(i))) {
+			append(result.strokes, piece->materialize());
+		}
+	}
+	cache.sweep();
+	return result;
+}
+
+auto Sketch::renderInstances(FlattenCache& cache) const
+-> std::vector<SharedInstances> {
+	std::vector<SharedInstances> result {};
+	result.reserve(elements.size());
+	for (std::size_t i=0; i<elements.size(); i++) {
+		append(result, cache.get(elements.shared(i)));
+	}
+	cache.sweep();
+	return result;
+}
+
+/* ~~ Streaming ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+namespace
+{
+	using Point = FlatStroke::Point;
+
+	// The matrices picked for one instance so far, first modifier
+	// first. Every link lives on walk()'s stack, so however long the
+	// modifier list gets, nothing is allocated.
+	struct Chain {
+		const Mod::Affine& matrix;
+		const Chain* next;
+	};
+
+	template <typename T>
+	auto apply(const Chain* c, T x) -> T {
+		for (; c; c = c->next) x = c->matrix(x);
+		return x;
+	}
+
+	auto boundsOf(const StrokeAtoms& atoms) { return atoms.bounds(); }
+	auto boundsOf(const FlatStrokeAtoms& atoms) {
+		std::pair<Point,Point> box {{0,0}, {-1,-1}};
+		bool first = true;
+		for (const auto& atom : atoms)
+		for (const Point& p : atom.points) {
+			if (first) box = {p, p}, first = false;
+			box.first  = {std::min(box.first.x , p.x), std::min(box.first.y , p.y)};
+			box.second = {std::max(box.second.x, p.x), std::max(box.second.y, p.y)};
+		}
+		return box;
+	}
+
+	template <typename Atoms>
+	struct Walker {
+		const Atoms* atoms; // (Or null to only ask which are wanted.)
+		std::pair<Point,Point> box;
+		StrokeVisitor& visitor;
+		bool wanted = false;
+
+		// Peels modifiers off the back, so the last one is the slowest
+		// to change, (same order applying them one by one gives).
+		void walk(std::span<const Mod::Of_Stroke> mods, const Chain* chain) {
+			if (mods.empty()) return emit(chain);
+
+			// Runs of Affines fold into one, left to right, the way
+			// strokeModsReduce does it.
+			std::size_t k = mods.size();
+			while (k > 0 && std::holds_alternative<Mod::Affine>(mods[k-1])) k--;
+			if (k < mods.size()) {
+				Mod::Affine product = std::get<Mod::Affine>(mods[k]);
+				for (std::size_t i=k+1; i<mods.size(); i++) {
+					product = product * std::get<Mod::Affine>(mods[i]);
 				}
+				const Chain link {product, chain};
+				return walk(mods.first(k), &link);
+			}
 
-				append(result.strokes, renderStrokes(strokes));
+			const auto& array = std::get<Mod::Array>(mods.back());
+			Mod::Affine power {1};
+			for (std::size_t n=0; n<array.N; n++, power = power * array.transformation) {
+				const Chain link {power, chain};
+				walk(mods.first(mods.size()-1), &link);
 			}
-		}, variant);
+		}
+
+		void emit(const Chain* chain) {
+			if (box.first.x <= box.second.x) {
+				auto [lo, hi] = apply(chain, box);
+				if (!visitor.wants(lo, hi)) return;
+			}
+			wanted = true;
+			if (!atoms) return;
+
+			for (const auto& atom : *atoms) {
+				visitor.beginStroke();
+				forEachPoint(atom, [&](Point p) {
+					visitor.point(apply(chain, p));
+				});
+			}
+		}
+	};
+}
+
+void Sketch::visit(StrokeVisitor& visitor) const {
+	for (const auto& element : elements) visitElement(element, visitor);
+}
+
+void visitElement(const Element& variant, StrokeVisitor& visitor) {
+	std::visit([&]<typename T>(const T& elem) {
+		if constexpr (HoldsStrokeMods<T>) {
+			Walker walker {&elem.atoms, boundsOf(elem.atoms), visitor};
+			walker.walk(elem.modifiers, nullptr);
+		}
+	}, variant);
+}
+
+auto strokeBounds(const Element& variant) -> std::pair<Point,Point> {
+	return std::visit([&]<typename T>(const T& elem) {
+		if constexpr (HoldsStrokeMods<T>) return boundsOf(elem.atoms);
+		else return std::pair<Point,Point> {{0,0}, {-1,-1}};
+	}, variant);
+}
+
+bool wantsAny(
+	StrokeVisitor& visitor,
+	std::pair<Point,Point> box,
+	const StrokeModifiers& modifiers
+) {
+	Walker<StrokeAtoms> walker {nullptr, box, visitor};
+	walker.walk(modifiers, nullptr);
+	return walker.wanted;
+}
+
+/* ~~ Flatten Cache ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+namespace
+{
+	struct Hasher {
+		uint64_t h = 0x6a09e667f3bcc909;
+
+		void add(uint64_t x) {
+			h = (h ^ x) * 0x9e3779b97f4a7c15;
+			h ^= h >> 32;
+		}
+		void add(double x) { add(std::bit_cast<uint64_t>(x)); }
+		void add(int x) { add(uint64_t(uint32_t(x))); }
+
+		void add(const StrokeAtoms& atoms) {
+			add(uint64_t(atoms.size()));
+			for (const StrokeAtoms::View s : atoms) {
+				add(uint64_t(s.diameter));
+				add(uint64_t(s.size()));
+				for (std::size_t i=0; i<s.size(); i++) {
+					add(int(s.x[i])), add(int(s.y[i])), add(uint64_t(s.pressure[i]));
+				}
+			}
+		}
+		void add(const FlatStroke& s) {
+			add(uint64_t(s.points.size()));
+			for (const auto& p : s.points) add(p.x), add(p.y);
+		}
+		void add(const Atom::Marker& m) {
+			add(uint64_t(m.text.size()));
+			for (char c : m.text) add(uint64_t(c));
+		}
+		template <typename T>
+		void add(const std::vector<T>& v) {
+			add(uint64_t(v.size()));
+			for (const auto& x : v) add(x);
+		}
+
+		void add(const Mod::Affine& a) { for (double x : a.matrix) add(x); }
+		void add(const Mod::Array& a) { add(uint64_t(a.N)), add(a.transformation); }
+		void add(const Mod::Uppercase&) {}
+		template <typename... Ts>
+		void add(const std::variant<Ts...>& v) {
+			add(uint64_t(v.index()));
+			std::visit([this](const auto& x) { add(x); }, v);
+		}
+	};
+}
+
+auto contentHash(const Element& variant) -> uint64_t {
+	Hasher hasher {};
+	hasher.add(uint64_t(variant.index()));
+	std::visit([&](const auto& elem) {
+		hasher.add(elem.atoms);
+		hasher.add(elem.modifiers);
+	}, variant);
+	return hasher.h;
+}
+
+namespace
+{
+	// Whether the modifiers leave just the one copy of the strokes,
+	// (so splitting them up keeps them in the same order).
+	bool single(const std::vector<FlatInstances::Stage>& stages) {
+		return ranges::all_of(stages, [](const auto& s) { return s.size() == 1; });
 	}
 
-	return result;
-}
\ No newline at end of file
+	// Flattens a Brush's strokes from the given one on, onto the runs
+	// already made of the ones before. A last run with room left is
+	// made again with the new strokes on the end, (copied, not
+	// flattened again).
+	void addRuns(
+		const Brush& brush, std::size_t from,
+		std::vector<SharedInstances>& runs, FlattenCache::Stats& counters
+	) {
+		constexpr std::size_t Run = FlattenCache::Run;
+		const std::size_t n = brush.atoms.size();
+		if (from == n) return;
+		const auto stages = stagesOf(brush.modifiers);
+
+		FlatStrokeAtoms run {};
+		if (from % Run) run = runs.back()->strokes, runs.pop_back();
+		for (std::size_t i=from; i<n; i++) {
+			run.push_back(renderStroke(brush.atoms[i]));
+			counters.strokes++;
+			if ((i+1) % Run && i+1 < n) continue;
+			runs.push_back(std::make_shared<const FlatInstances>(std::move(run), stages));
+			run = {};
+			counters.misses++;
+		}
+	}
+}
+
+// The entry of the element drawn in the same place last render, if
+// it's a Brush that this one is, with strokes added on.
+auto FlattenCache::grown(const Element& element) const -> const Entry* {
+	const std::size_t place = current.size()-1;
+	auto* brush = std::get_if<Brush>(&element);
+	if (!brush || place >= previous.size()) return nullptr;
+	auto it = entries.find(previous[place].get());
+	if (it == entries.end() || !it->second.runs) return nullptr;
+	auto& before = std::get<Brush>(*it->second.element);
+	if (before.modifiers != brush->modifiers || !before.atoms.prefixOf(brush->atoms)) return nullptr;
+	return &it->second;
+}
+
+auto FlattenCache::get(ElementPtr element) -> std::span<const SharedInstances> {
+	current.push_back(element);
+	const Element* key = element.get();
+	if (auto it = entries.find(key); it != entries.end()) {
+		counters.hits += it->second.pieces.size();
+		it->second.lastUsed = generation;
+		return it->second.pieces;
+	}
+
+	Entry entry {std::move(element), 0, {}, false, generation};
+	const Element& e = *entry.element;
+	const auto* brush = std::get_if<Brush>(&e);
+	entry.runs = brush && single(stagesOf(brush->modifiers));
+
+	if (const Entry* before = grown(e)) {
+		// (Too quick to want hashing, so found by place and not content.)
+		entry.pieces = before->pieces;
+		counters.hits += entry.pieces.size() - (std::get<Brush>(*before->element).atoms.size() % Run != 0);
+		addRuns(*brush, std::get<Brush>(*before->element).atoms.size(), entry.pieces, counters);
+		return entries.emplace(key, std::move(entry)).first->second.pieces;
+	}
+
+	// New to the cache, so hashed, (just this once), in case an equal
+	// element's been flattened. A hash that matches is only trusted
+	// once the contents do too.
+	entry.hash = contentHash(e);
+	if (auto it = byContent.find(entry.hash); it != byContent.end()
+	&&  *entries.at(it->second).element == e) {
+		entry.pieces = entries.at(it->second).pieces;
+		counters.hits += entry.pieces.size();
+	}
+	else if (entry.runs) addRuns(*brush, 0, entry.pieces, counters);
+	else {
+		auto instances = std::make_shared<const FlatInstances>(flatten(e));
+		counters.misses++;
+		counters.strokes += instances->strokes.size();
+		entry.pieces = {std::move(instances)};
+	}
+	byContent[entry.hash] = key;
+	return entries.emplace(key, std::move(entry)).first->second.pieces;
+}
+
+void FlattenCache::sweep() {
+	std::erase_if(entries, [this](const auto& kv) {
+		const Entry& entry = kv.second;
+		if (generation - entry.lastUsed < MaxAge) return false;
+		if (auto it = byContent.find(entry.hash); it != byContent.end() && it->second == kv.first) {
+			byContent.erase(it);
+		}
+		return true;
+	});
+	previous = std::move(current);
+	current.clear();
+	generation++;
+}
+
+auto FlattenCache::stats() const -> Stats {
+	return {counters.hits, counters.misses, entries.size(), counters.strokes};
+}
+
+void FlattenCache::resetStats() { counters = {}; }
@@ -0,0 +1,106 @@
+#include "threadPool.hh"
+#include <algorithm>
+#include <optional>
+
+auto ThreadPool::defaultSize() -> std::size_t {
+#	if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+		return 1;
+#	else
+		return std::max(1u, std::thread::hardware_concurrency());
+#	endif
+}
+
+ThreadPool::ThreadPool(std::size_t size) {
+	size = std::max(size, 1uz);
+	for (std::size_t i=0; i<size; i++) {
+		queues.push_back(std::make_unique<Queue>());
+	}
+	for (std::size_t i=0; i<size-1; i++) {
+		workers.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock {mutex};
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& w : workers) w.join();
+}
+
+auto ThreadPool::size() const -> std::size_t { return queues.size(); }
+
+/* ~~ Scheduling ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void ThreadPool::parallelFor(
+	std::size_t n,
+	const std::function<void(std::size_t)>& f,
+	std::size_t grain
+) {
+	if (n == 0) return;
+	grain = std::max(grain, 1uz);
+	if (workers.empty() || n <= grain) {
+		for (std::size_t i=0; i<n; i++) f(i);
+		return;
+	}
+
+	std::lock_guard turn {running};
+	job = &f;
+	remaining = n;
+
+	// Deal the chunks out round-robin, so every queue starts
+	// with about the same amount of work.
+	for (std::size_t i=0, q=0; i<n; i+=grain, q=(q+1) % queues.size()) {
+		std::lock_guard lock {queues[q]->mutex};
+		queues[q]->tasks.push_back({i, std::min(i+grain, n)});
+	}
+
+	{
+		std::lock_guard lock {mutex};
+		generation++;
+	}
+	wake.notify_all();
+
+	const std::size_t self = queues.size()-1;
+	while (runTask(self)) {}
+
+	std::unique_lock lock {mutex};
+	done.wait(lock, [&] { return remaining == 0; });
+	job = nullptr;
+}
+
+bool ThreadPool::runTask(std::size_t self) {
+	std::optional<Task> task {};
+
+	// Our own queue from the front, everyone else's from the back.
+	for (std::size_t k=0; k<queues.size() && !task; k++) {
+		Queue& q = *queues[(self + k) % queues.size()];
+		std::lock_guard lock {q.mutex};
+		if (q.tasks.empty()) continue;
+		if (k == 0) task = q.tasks.front(), q.tasks.pop_front();
+		else /*  */ task = q.tasks.back() , q.tasks.pop_back();
+	}
+	if (!task) return false;
+
+	for (std::size_t i=task->begin; i<task->end; i++) (*job)(i);
+
+	const std::size_t count = task->end - task->begin;
+	if (remaining.fetch_sub(count) == count) {
+		std::lock_guard lock {mutex};
+		done.notify_all();
+	}
+	return true;
+}
+
+void ThreadPool::workerLoop(std::size_t self) {
+	for (std::size_t seen = 0;;) {
+		{
+			std::unique_lock lock {mutex};
+			wake.wait(lock, [&] { return stopping || generation != seen; });
+			if (stopping) return;
+			seen = generation;
+		}
+		while (runTask(self)) {}
+	}
+}
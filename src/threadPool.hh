@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for splitting up loops. Each worker
+// has its own queue of tasks and, once it runs dry, steals from the
+// far end of the others. A pool of size 1 has no workers at all and
+// just runs everything on the calling thread.
+class ThreadPool {
+	struct Task { std::size_t begin, end; };
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::thread> workers;
+	// One per worker, plus a last one for the calling thread.
+	std::vector<std::unique_ptr<Queue>> queues;
+
+	std::mutex mutex, running;
+	std::condition_variable wake, done;
+	std::size_t generation = 0;
+	bool stopping = false;
+
+	const std::function<void(std::size_t)>* job = nullptr;
+	std::atomic<std::size_t> remaining = 0;
+
+	bool runTask(std::size_t self);
+	void workerLoop(std::size_t self);
+
+public:
+	// Threads available to us, (just 1 in a non-pthreads wasm build).
+	static auto defaultSize() -> std::size_t;
+
+	explicit ThreadPool(std::size_t size = defaultSize());
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Counting the calling thread.
+	auto size() const -> std::size_t;
+
+	// Calls f(i) for every i in [0,n), spread over the pool in chunks
+	// of grain indices, and returns once they've all finished. The
+	// calling thread works too. Calls from several threads take turns.
+	void parallelFor(
+		std::size_t n,
+		const std::function<void(std::size_t)>& f,
+		std::size_t grain = 1
+	);
+};
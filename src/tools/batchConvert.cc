@@ -0,0 +1,235 @@
+#include "../parsers.hh"
+#include "../threadPool.hh"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Converts whole corpora of sketches between the raw ".sketch" format,
+// .hsc, and .hsc flattened down to a single Data element, a file per
+// task on a thread pool. Each file is read and written a stroke (or an
+// element) at a time, so memory stays at a couple of chunks per thread
+// however big the files are. Errors are listed per file at the end,
+// with where in the file they happened. Outputs are all checked before
+// anything's written: two files can't go to the same place, and a file
+// is only written over its own input when asked to, (with -f).
+
+namespace fs = std::filesystem;
+
+enum class Format { Raw, Hsc, Data };
+
+struct Job {
+	fs::path from, to;
+	std::string error {};
+	std::uintmax_t bytesIn = 0, bytesOut = 0;
+};
+
+auto usage(const char* name) -> int {
+	std::fprintf(stderr,
+		"usage: %s -t raw|hsc|data [-o outdir] [-j threads] [-f] <input>...\n"
+		"  inputs are files, directories (searched for .sketch and .hsc\n"
+		"  files), or @list for a file listing one path a line.\n"
+		"  Outputs go next to their inputs unless given an outdir, (where\n"
+		"  directories keep their layout), with extension .sketch for raw\n"
+		"  and .hsc otherwise. -f lets a file be converted in place.\n", name);
+	return 2;
+}
+
+auto isRaw(const fs::path& p) -> bool { return p.extension() == ".sketch"; }
+auto isSketch(const fs::path& p) -> bool { return isRaw(p) || p.extension() == ".hsc"; }
+
+// Where an error was, for the per-file report.
+auto describe(const auto& error) -> std::string {
+	return "error " + std::to_string(int(error.type)) + " at "
+	+ std::to_string(error.pos.row) + ":" + std::to_string(error.pos.col);
+}
+
+// The strokes an element draws, (modifiers and all).
+auto flattened(Element element) -> std::vector<Atom::FlatStroke> {
+	return Sketch {std::vector<Element> {std::move(element)}}.render().strokes;
+}
+
+// Raw points are 2 base-36 digits each way.
+auto fitsRaw(const Atom::FlatStroke& s) -> bool {
+	for (const auto p : s.points) {
+		if (p.x < 0 || p.y < 0 || p.x >= 36*36 || p.y >= 36*36) return false;
+	}
+	return true;
+}
+
+// Converts one file, giving what went wrong if anything did.
+auto convert(const fs::path& from, std::ostream& os, Format format) -> std::string {
+	std::ifstream input {from, std::ios::binary};
+	if (!input) return "can't open";
+	TextWriter writer {os};
+	const char* open  = format == Format::Raw ? "" : "Data [ ";
+	const char* close = format == Format::Raw ? "" : "];";
+
+	if (isRaw(from)) {
+		// (Either way out, it's the same strokes.)
+		RawFormat::Reader reader {input};
+		writer.write(open);
+		while (true) {
+			auto stroke = reader.next();
+			if (!stroke) return describe(stroke.error());
+			if (!*stroke) break;
+			if (format == Format::Raw) writer.writeRaw(**stroke);
+			else writer.write(**stroke);
+		}
+		writer.write(close);
+		return {};
+	}
+
+	SketchFormat::Reader reader {input};
+	if (format != Format::Hsc) writer.write(open);
+	for (bool first = true; ; first = false) {
+		auto element = reader.next();
+		if (!element) return describe(element.error());
+		if (!*element) break;
+
+		if (format == Format::Hsc) {
+			if (!first) writer.write(",\n");
+			writer.write(**element);
+			continue;
+		}
+		for (const auto& stroke : flattened(std::move(**element))) {
+			if (format == Format::Data) { writer.write(stroke); continue; }
+			if (!fitsRaw(stroke)) return "points outside of the raw format's range";
+			writer.writeRaw(stroke);
+		}
+	}
+	writer.write(format == Format::Hsc ? ";" : close);
+	return {};
+}
+
+// Where a path really points, so the same file spelled two ways is
+// seen as one.
+auto resolved(const fs::path& p) -> fs::path {
+	std::error_code ec;
+	auto result = fs::weakly_canonical(fs::absolute(p), ec);
+	return ec ? fs::absolute(p).lexically_normal() : result;
+}
+
+// What's wrong with where the jobs would write, if anything: outputs
+// shared between jobs, or landing on another job's input, (which could
+// be being read right then), or on their own without -f.
+auto clashes(const std::vector<Job>& jobs, bool inPlace) -> std::vector<std::string> {
+	std::map<fs::path, std::size_t> inputs {}, outputs {};
+	std::vector<std::string> problems {};
+	for (std::size_t i=0; i<jobs.size(); i++) inputs.emplace(resolved(jobs[i].from), i);
+	for (std::size_t i=0; i<jobs.size(); i++) {
+		const Job& job = jobs[i];
+		const fs::path to = resolved(job.to);
+		if (auto [it, added] = outputs.emplace(to, i); !added) {
+			problems.push_back(job.from.string() + ": same output as " + jobs[it->second].from.string());
+		}
+		const auto it = inputs.find(to);
+		if (it == inputs.end()) continue;
+		if (it->second != i) {
+			problems.push_back(job.from.string() + ": output would overwrite input " + jobs[it->second].from.string());
+		}
+		else if (!inPlace) {
+			problems.push_back(job.from.string() + ": output would overwrite it, (use -f to allow)");
+		}
+	}
+	return problems;
+}
+
+void run(Job& job, Format format) {
+	std::error_code ec;
+	job.bytesIn = fs::file_size(job.from, ec);
+	if (job.to.has_parent_path()) fs::create_directories(job.to.parent_path(), ec);
+
+	// Written alongside, then moved over, (so an input can be its own
+	// output, and a failure leaves nothing half written behind).
+	fs::path part = job.to;
+	part += ".part";
+	{
+		std::ofstream output {part, std::ios::binary};
+		if (!output) { job.error = "can't write " + part.string(); return; }
+		job.error = convert(job.from, output, format);
+		if (job.error.empty() && !output.flush()) job.error = "can't write " + part.string();
+	}
+	if (!job.error.empty()) { fs::remove(part, ec); return; }
+	fs::rename(part, job.to, ec);
+	if (ec) { job.error = "can't write " + job.to.string(); return; }
+	job.bytesOut = fs::file_size(job.to, ec);
+}
+
+int main(int argc, char** argv) {
+	std::optional<Format> format {};
+	std::optional<fs::path> outDir {};
+	std::size_t threads = ThreadPool::defaultSize();
+	bool inPlace = false;
+	std::vector<std::string> inputs {};
+	for (int i=1; i<argc; i++) {
+		const std::string arg = argv[i];
+		const bool hasValue = i+1 < argc;
+		if (arg == "-t" && hasValue) {
+			const std::string t = argv[++i];
+			if      (t == "raw" ) format = Format::Raw;
+			else if (t == "hsc" ) format = Format::Hsc;
+			else if (t == "data") format = Format::Data;
+			else return usage(argv[0]);
+		}
+		else if (arg == "-o" && hasValue) outDir = argv[++i];
+		else if (arg == "-j" && hasValue) threads = std::max(1l, std::atol(argv[++i]));
+		else if (arg == "-f") inPlace = true;
+		else if (arg.starts_with("-")) return usage(argv[0]);
+		else inputs.push_back(arg);
+	}
+	if (!format || inputs.empty()) return usage(argv[0]);
+
+	// Each file, and what its output's path is relative to.
+	std::vector<Job> jobs {};
+	auto add = [&](const fs::path& file, const fs::path& base) {
+		fs::path to = outDir ? *outDir / file.lexically_relative(base) : file;
+		to.replace_extension(*format == Format::Raw ? ".sketch" : ".hsc");
+		jobs.push_back({file, to});
+	};
+	for (const std::string& input : inputs) {
+		if (input.starts_with("@")) {
+			std::ifstream list {input.substr(1)};
+			if (!list) { std::fprintf(stderr, "can't open %s\n", input.c_str()+1); return 1; }
+			for (std::string line; std::getline(list, line); ) {
+				if (!line.empty()) add(line, fs::path {line}.parent_path());
+			}
+		}
+		else if (fs::is_directory(input)) {
+			for (const auto& entry : fs::recursive_directory_iterator {input}) {
+				if (entry.is_regular_file() && isSketch(entry.path())) add(entry.path(), input);
+			}
+		}
+		else add(input, fs::path {input}.parent_path());
+	}
+
+	if (const auto problems = clashes(jobs, inPlace); !problems.empty()) {
+		for (const std::string& problem : problems) std::fprintf(stderr, "%s\n", problem.c_str());
+		std::fprintf(stderr, "nothing converted\n");
+		return 1;
+	}
+
+	ThreadPool pool {threads};
+	const auto t0 = std::chrono::steady_clock::now();
+	pool.parallelFor(jobs.size(), [&](std::size_t i) { run(jobs[i], *format); });
+	const auto t1 = std::chrono::steady_clock::now();
+	const double seconds = std::chrono::duration<double>(t1-t0).count();
+
+	std::size_t failed = 0;
+	std::uintmax_t bytesIn = 0, bytesOut = 0;
+	for (const Job& job : jobs) {
+		bytesIn += job.bytesIn, bytesOut += job.bytesOut;
+		if (job.error.empty()) continue;
+		std::fprintf(stderr, "%s: %s\n", job.from.c_str(), job.error.c_str());
+		failed++;
+	}
+	std::printf("%zu files, (%zu failed), on %zu threads\n", jobs.size(), failed, pool.size());
+	std::printf("%.1f MB in, %.1f MB out, %.2f s, %.0f files/s, %.1f MB/s\n",
+		bytesIn / 1e6, bytesOut / 1e6, seconds,
+		jobs.size() / seconds, bytesIn / 1e6 / seconds);
+	return failed ? 1 : 0;
+}
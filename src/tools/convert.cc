@@ -0,0 +1,35 @@
+#include "../parsers.hh"
+#include "../mappedFile.hh"
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+// Converts a sketch between the text (.hsc) and binary (.hscb) formats.
+// The input's format is told by its first bytes, the output's by its
+// name, so converting a file to its own format just tidies it up.
+
+int main(int argc, char** argv) {
+	if (argc != 3) {
+		std::fprintf(stderr, "usage: %s <input> <output>\n", argv[0]);
+		std::fprintf(stderr, "  (writes binary if output ends in .hscb, text otherwise)\n");
+		return 2;
+	}
+	const std::string from = argv[1], to = argv[2];
+
+	auto input = MappedFile::open(from);
+	if (!input) { std::fprintf(stderr, "can't open %s\n", from.c_str()); return 1; }
+	auto sketch = input->view().starts_with(BinaryFormat::Magic)
+		? BinaryFormat::parse(input->view())
+		: SketchFormat::parse(input);
+	if (!sketch) {
+		std::fprintf(stderr, "%s: error %d at %zu:%zu\n", from.c_str(),
+			int(sketch.error()), sketch.error().pos.row, sketch.error().pos.col);
+		return 1;
+	}
+
+	std::ofstream output {to, std::ios::binary};
+	if (to.ends_with(".hscb")) BinaryFormat::print(output, *sketch);
+	else SketchFormat::print(output, *sketch);
+	if (!output.flush()) { std::fprintf(stderr, "can't write %s\n", to.c_str()); return 1; }
+	return 0;
+}
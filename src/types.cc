@@ -2,6 +2,8 @@
 #include "base36.hh"
 #include "util.hh"
 #include <algorithm>
+#include <charconv>
+#include <cmath>
 
 /* ~~ Points & Strokes ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
@@ -28,6 +30,116 @@ Atom::FlatStroke::FlatStroke(std::vector<Point> v)
 Atom::FlatStroke::Point::Point(int x, int y)
 : x{x}, y{y} {}
 
+/* ~~ Stroke Atoms ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+StrokeAtoms::StrokeAtoms() {}
+StrokeAtoms::StrokeAtoms(const std::vector<Atom::Stroke>& strokes) {
+	reserve(strokes.size());
+	for (const Atom::Stroke& s : strokes) push_back(s);
+}
+
+void StrokeAtoms::push_back(const Atom::Stroke& s) {
+	if (!columns) {
+		columns = std::make_shared<Columns>();
+	}
+	else if (columns->diameters.size() != strokes) {
+		const Columns& old = *columns;
+		const std::size_t points = old.offsets[strokes];
+		columns = std::make_shared<Columns>(Columns {
+			{old.xs.begin(), old.xs.begin() + points},
+			{old.ys.begin(), old.ys.begin() + points},
+			{old.pressures.begin(), old.pressures.begin() + points},
+			{old.offsets.begin(), old.offsets.begin() + strokes+1},
+			{old.diameters.begin(), old.diameters.begin() + strokes},
+		});
+	}
+
+	// Anything past what the columns hold is clamped, not wrapped,
+	// (neither file format can hold it anyway).
+	Columns& c = *columns;
+	for (const auto& p : s.points) {
+		c.xs.push_back(std::clamp<int>(p.x, INT16_MIN, INT16_MAX));
+		c.ys.push_back(std::clamp<int>(p.y, INT16_MIN, INT16_MAX));
+		c.pressures.push_back(std::lround(std::clamp(p.pressure, 0.0, 1.0) * PressureMax));
+	}
+	c.offsets.push_back(c.xs.size());
+	c.diameters.push_back(std::min<unsigned>(s.diameter, UINT16_MAX));
+	strokes++;
+}
+
+void StrokeAtoms::reserve(std::size_t n) {
+	if (!columns) columns = std::make_shared<Columns>();
+	if (columns->diameters.size() != strokes) return;
+	columns->offsets.reserve(n + 1);
+	columns->diameters.reserve(n);
+}
+
+bool StrokeAtoms::operator==(const StrokeAtoms& other) const {
+	if (strokes != other.strokes) return false;
+	if (strokes == 0 || columns == other.columns) return true;
+	const Columns& a = *columns;
+	const Columns& b = *other.columns;
+	const std::size_t points = a.offsets[strokes];
+	auto same = [&](const auto& u, const auto& v, std::size_t n) {
+		return std::equal(u.begin(), u.begin() + n, v.begin());
+	};
+	return same(a.offsets, b.offsets, strokes+1)
+	&&     same(a.diameters, b.diameters, strokes)
+	&&     same(a.xs, b.xs, points)
+	&&     same(a.ys, b.ys, points)
+	&&     same(a.pressures, b.pressures, points);
+}
+
+bool StrokeAtoms::prefixOf(const StrokeAtoms& other) const {
+	return strokes == 0 || (columns == other.columns && strokes <= other.strokes);
+}
+
+auto StrokeAtoms::size() const -> std::size_t { return strokes; }
+bool StrokeAtoms::empty() const { return strokes == 0; }
+
+auto StrokeAtoms::operator[](std::size_t i) const -> View {
+	const Columns& c = *columns;
+	const std::size_t begin = c.offsets[i], n = c.offsets[i+1] - begin;
+	return View {
+		c.diameters[i],
+		std::span {c.xs}.subspan(begin, n),
+		std::span {c.ys}.subspan(begin, n),
+		std::span {c.pressures}.subspan(begin, n),
+	};
+}
+
+auto StrokeAtoms::begin() const -> Iterator { return {this, 0}; }
+auto StrokeAtoms::end() const -> Iterator { return {this, size()}; }
+
+auto StrokeAtoms::bounds() const
+-> std::pair<Atom::FlatStroke::Point, Atom::FlatStroke::Point> {
+	const std::size_t points = strokes ? columns->offsets[strokes] : 0;
+	if (points == 0) return {{0,0}, {-1,-1}};
+	auto [x0, x1] = ranges::minmax(std::span {columns->xs}.first(points));
+	auto [y0, y1] = ranges::minmax(std::span {columns->ys}.first(points));
+	return {{x0, y0}, {x1, y1}};
+}
+
+auto StrokeAtoms::View::size() const -> std::size_t { return x.size(); }
+
+auto StrokeAtoms::View::operator[](std::size_t i) const -> Atom::Stroke::Point {
+	return {x[i], y[i], pressure[i] / double(PressureMax)};
+}
+
+StrokeAtoms::View::operator Atom::Stroke() const {
+	Atom::Stroke result {diameter, {}};
+	result.points.reserve(size());
+	for (std::size_t i=0; i<size(); i++) result.points.push_back((*this)[i]);
+	return result;
+}
+
+StrokeAtoms::Iterator::Iterator(const StrokeAtoms* atoms, std::size_t i)
+: atoms{atoms}, i{i} {}
+
+auto StrokeAtoms::Iterator::operator*() const -> View { return (*atoms)[i]; }
+auto StrokeAtoms::Iterator::operator++() -> Iterator& { ++i; return *this; }
+auto StrokeAtoms::Iterator::operator++(int) -> Iterator { auto old = *this; ++i; return old; }
+
 /* ~~ From Flat Constructors ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 Atom::Stroke::Stroke(const Atom::FlatStroke& flat) {
@@ -69,6 +181,37 @@ auto Mod::Affine::operator*(Affine other) const -> Affine {
 	});
 }
 
+auto Mod::Affine::operator()(Atom::FlatStroke::Point p)
+const -> Atom::FlatStroke::Point {
+	const auto& m = this->matrix;
+	return {
+		int(m[0]*p.x + m[1]*p.y + m[2]),
+		int(m[3]*p.x + m[4]*p.y + m[5]),
+	};
+}
+
+auto Mod::Affine::operator()(
+	std::pair<Atom::FlatStroke::Point, Atom::FlatStroke::Point> box
+) const -> std::pair<Atom::FlatStroke::Point, Atom::FlatStroke::Point> {
+	// The box's corners bound the transformed points, and truncating
+	// towards 0 never leaves the floor/ceiling of each coordinate.
+	const auto& m = this->matrix;
+	const auto [lo, hi] = box;
+	double x0 = +INFINITY, y0 = +INFINITY;
+	double x1 = -INFINITY, y1 = -INFINITY;
+	for (int cx : {lo.x, hi.x})
+	for (int cy : {lo.y, hi.y}) {
+		double x = m[0]*cx + m[1]*cy + m[2];
+		double y = m[3]*cx + m[4]*cy + m[5];
+		x0 = std::min(x0, x), x1 = std::max(x1, x);
+		y0 = std::min(y0, y), y1 = std::max(y1, y);
+	}
+	return {
+		{int(std::floor(x0)), int(std::floor(y0))},
+		{int(std::ceil (x1)), int(std::ceil (y1))},
+	};
+}
+
 auto Mod::Affine::operator()(std::span<const Atom::Stroke> strokes)
 const -> std::vector<Atom::Stroke> {
 	auto multiplyP = [&m = this->matrix](Atom::Stroke::Point p) {
@@ -97,16 +240,27 @@ Mod::Array::Array(std::size_t n, Affine tf) : N{n}, transformation{tf} {}
 
 auto Mod::Array::operator()(std::span<const Atom::Stroke> strokes)
 const -> std::vector<Atom::Stroke> {
-	auto applyMatPower = [this, &strokes](std::size_t i) {
-		return Util::pow(transformation, i)(strokes);
+	auto applyMatPower = [&strokes](const Affine& power) {
+		return power(strokes);
 	};
 
-	return views::iota(0uz, N)
+	return powers()
 		| views::transform(applyMatPower)
 		| views::join // Labeled under "experimental-library".
 		| ranges::to<std::vector>();
 }
 
+auto Mod::Array::powers() const -> std::vector<Affine> {
+	// Multiplied up one at a time, which is what Util::pow
+	// does too, so each power comes out bit-for-bit the same.
+	std::vector<Affine> result {};
+	result.reserve(N);
+	for (Affine power {1}; result.size() < N; power = power * transformation) {
+		result.push_back(power);
+	}
+	return result;
+}
+
 Mod::Uppercase::Uppercase() {}
 
 auto Mod::Uppercase::operator()(std::span<const Atom::Marker> markers)
@@ -124,103 +278,280 @@ const -> std::vector<Atom::Marker> {
 		| ranges::to<std::vector>();
 }
 
-/* ~~ Print Sketch ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+/* ~~ Flat Instances ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+FlatInstances::FlatInstances()
+: baseBounds{{0,0}, {-1,-1}}, allBounds{baseBounds} {}
+
+FlatInstances::FlatInstances(FlatStrokeAtoms s, std::vector<Stage> st)
+: strokes{std::move(s)}, stages{std::move(st)}
+, baseBounds{{0,0}, {-1,-1}}, allBounds{baseBounds} {
+	auto& [lo, hi] = baseBounds;
+	bool first = true;
+	for (const auto& stroke : strokes)
+	for (const Point& p : stroke.points) {
+		if (first) lo = hi = p, first = false;
+		lo = {std::min(lo.x, p.x), std::min(lo.y, p.y)};
+		hi = {std::max(hi.x, p.x), std::max(hi.y, p.y)};
+	}
+	if (first || size() == 0) return;
 
-std::ostream& operator<<(std::ostream& os, const Sketch& sketch) {
+	allBounds = bounds(0);
+	for (std::size_t i=1; i<size(); i++) {
+		auto [l, h] = bounds(i);
+		allBounds.first  = {std::min(allBounds.first.x , l.x), std::min(allBounds.first.y , l.y)};
+		allBounds.second = {std::max(allBounds.second.x, h.x), std::max(allBounds.second.y, h.y)};
+	}
+}
+
+auto FlatInstances::size() const -> std::size_t {
+	std::size_t result = 1;
+	for (const Stage& stage : stages) result *= stage.size();
+	return result;
+}
+
+// Instances count up like a number with one digit per stage,
+// the first stage being the fastest changing digit.
+auto FlatInstances::apply(std::size_t i, Point p) const -> Point {
+	for (const Stage& stage : stages) {
+		p = stage[i % stage.size()](p);
+		i /= stage.size();
+	}
+	return p;
+}
+
+auto FlatInstances::bounds(std::size_t i) const -> std::pair<Point,Point> {
+	if (baseBounds.first.x > baseBounds.second.x) return baseBounds;
+
+	std::pair<Point,Point> box = baseBounds;
+	for (const Stage& stage : stages) {
+		box = stage[i % stage.size()](box);
+		i /= stage.size();
+	}
+	return box;
+}
+
+auto FlatInstances::bounds() const -> std::pair<Point,Point> {
+	return allBounds;
+}
+
+auto FlatInstances::materialize() const -> FlatStrokeAtoms {
+	FlatStrokeAtoms result {};
+	result.reserve(size() * strokes.size());
+	for (std::size_t i=0; i<size(); i++)
+	for (const auto& stroke : strokes) {
+		Atom::FlatStroke& s = result.emplace_back();
+		s.points.reserve(stroke.points.size());
+		for (const Point& p : stroke.points) {
+			s.points.push_back(apply(i, p));
+		}
+	}
+	return result;
+}
+
+/* ~~ Text Writer ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+TextWriter::TextWriter(std::string& output)
+: buffer{output} {}
+
+TextWriter::TextWriter(std::ostream& output)
+: buffer{chunk}, sink{&output} {}
+
+TextWriter::~TextWriter() { flush(); }
+
+void TextWriter::flush() {
+	if (!sink) return;
+	sink->write(buffer.data(), buffer.size());
+	buffer.clear();
+}
+
+void TextWriter::flushIfFull() {
+	if (buffer.size() >= ChunkSize) flush();
+}
+
+auto TextWriter::reserve(std::size_t n) -> char* {
+	const std::size_t used = buffer.size();
+	buffer.resize(used + n);
+	return buffer.data() + used;
+}
+
+void TextWriter::commit(char* end) {
+	buffer.resize(end - buffer.data());
+}
+
+void TextWriter::put(std::string_view str) { buffer += str; }
+void TextWriter::write(std::string_view str) { put(str); }
+
+void TextWriter::put(double d) {
+	// (What an ostream's default format gives, which is %g.)
+	char* out = reserve(32);
+	commit(std::to_chars(out, out+32, d, std::chars_format::general, 6).ptr);
+}
+
+void TextWriter::put(std::size_t n) {
+	char* out = reserve(20);
+	commit(std::to_chars(out, out+20, n).ptr);
+}
+
+/* ~~ Write Sketch ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void TextWriter::write(const Sketch& sketch) {
 	for (std::size_t i = sketch.elements.size()
 	;    const Element& e : sketch.elements) {
-		os << e << (--i ? ",\n" : "");
+		write(e);
+		if (--i) put(",\n");
+		flushIfFull();
 	}
-	return os << ";";
+	put(";");
 }
 
-std::ostream& operator<<(std::ostream& os, const Element& element) {
+void TextWriter::write(const Element& element) {
 	std::visit(Util::Overloaded {
-		[&os](const Brush&)  { os << "Brush " ; },
-		[&os](const Pencil&) { os << "Pencil "; },
-		[&os](const Data&)   { os << "Data "  ; },
-		[&os](const Marker&) { os << "Marker "; },
+		[this](const Brush&)  { put("Brush " ); },
+		[this](const Pencil&) { put("Pencil "); },
+		[this](const Data&)   { put("Data "  ); },
+		[this](const Marker&) { put("Marker "); },
 	}, element);
 
-	std::visit([&os](auto&& e) {
-		os << e.atoms << e.modifiers;
+	std::visit([this](auto&& e) {
+		write(e.atoms);
+		write(e.modifiers);
 	}, element);
-
-	return os;
 }
 
-/* ~~ Print Atoms ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
-
-std::ostream& operator<<(std::ostream& os, const StrokeAtoms& v) {
-	os << "[ ";
-	for (Atom::Stroke s : v) {
-		os << Base36::toString<2,unsigned>(s.diameter) << " ";
-		for (std::size_t i = s.points.size()
-		;    const auto& p : s.points) {
-			os << Base36::toString<3,signed>(p.x)
-			   << Base36::toString<3,signed>(p.y)
-			   << "\'";
-			unsigned pressure = (36*36-1) * p.pressure;
-			os << Base36::toString<2,unsigned>(pressure)
-			   << (--i ? "\'" : "");
+/* ~~ Write Atoms ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void TextWriter::write(const StrokeAtoms& v) {
+	put("[ ");
+	for (const StrokeAtoms::View s : v) {
+		// Diameter and a space, 10 chars a point, and a space.
+		char* out = reserve(2+1 + 10*s.size() + 1);
+		out = Base36::toChars<2,unsigned>(s.diameter, out);
+		*out++ = ' ';
+		for (std::size_t i=0; i<s.size(); i++) {
+			out = Base36::toChars<3,signed>(int(s.x[i]), out);
+			out = Base36::toChars<3,signed>(int(s.y[i]), out);
+			*out++ = '\'';
+			out = Base36::toChars<2,unsigned>(unsigned(s.pressure[i]), out);
+			if (i+1 < s.size()) *out++ = '\'';
 		}
-		os << " ";
+		*out++ = ' ';
+		commit(out);
+		flushIfFull();
 	}
-	return os << "]";
+	put("]");
 }
 
-std::ostream& operator<<(std::ostream& os, const FlatStrokeAtoms& v) {
-	os << "[ ";
-	for (Atom::FlatStroke s : v) {
-		for (std::size_t i = s.points.size()
-		;    const auto& p : s.points) {
-			os << Base36::toString<3,signed>(p.x)
-			   << Base36::toString<3,signed>(p.y)
-			   << (--i ? "\'" : "");
-		}
-		os << " ";
+void TextWriter::write(const FlatStrokeAtoms& v) {
+	put("[ ");
+	for (const Atom::FlatStroke& s : v) write(s);
+	put("]");
+}
+
+void TextWriter::write(const Atom::FlatStroke& s) {
+	char* out = reserve(7*s.points.size() + 1);
+	for (std::size_t i = s.points.size()
+	;    const auto& p : s.points) {
+		out = Base36::toChars<3,signed>(p.x, out);
+		out = Base36::toChars<3,signed>(p.y, out);
+		if (--i) *out++ = '\'';
 	}
-	return os << "]";
+	*out++ = ' ';
+	commit(out);
+	flushIfFull();
 }
 
-std::ostream& operator<<(std::ostream& os, const MarkerAtom& m) {
-	return os << "(" << m.text << ")";
+void TextWriter::write(const MarkerAtom& m) {
+	put("(");
+	put(m.text);
+	put(")");
 }
 
-/* ~~ Print Modifiers ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+void TextWriter::writeRaw(const FlatSketch& sketch) {
+	for (const auto& s : sketch.strokes) writeRaw(s);
+}
 
-std::ostream& operator<<(std::ostream& os, const StrokeModifiers v) {
+void TextWriter::writeRaw(const Atom::FlatStroke& s) {
+	char* out = reserve(1 + 4*s.points.size());
+	*out++ = ' ';
+	for (const auto& p : s.points) {
+		out = Base36::toChars<2,unsigned>(p.x, out);
+		out = Base36::toChars<2,unsigned>(p.y, out);
+	}
+	commit(out);
+	flushIfFull();
+}
+
+/* ~~ Write Modifiers ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void TextWriter::write(const StrokeModifiers& v) {
 	for (const Mod::Of_Stroke& mod : v) {
-		os << "\n\t";
+		put("\n\t");
 		std::visit(Util::Overloaded {
-			[&os](const Mod::Affine& a) {
-				os << "Affine [ ";
-				for (std::size_t i=0; i<9; i++) {
-					os << a.matrix[i] << " ";
-				}
-				os << "]";
+			[this](const Mod::Affine& a) {
+				put("Affine [ ");
+				for (double d : a.matrix) put(d), put(" ");
+				put("]");
 			},
-			[&os](const Mod::Array& a) {
-				os << "Array [ ";
-				os << a.N << " ";
-				for (std::size_t i=0; i<9; i++) {
-					os << a.transformation.matrix[i] << " ";
-				}
-				os << "]";
+			[this](const Mod::Array& a) {
+				put("Array [ ");
+				put(a.N);
+				put(" Affine [ ");
+				for (double d : a.transformation.matrix) put(d), put(" ");
+				put("] ]");
 			},
 		}, mod);
 	}
-	return os;
 }
 
-std::ostream& operator<<(std::ostream& os, const MarkerModifiers v) {
+void TextWriter::write(const MarkerModifiers& v) {
 	for (const Mod::Of_Marker& mod : v) {
-		os << "\n\t";
+		put("\n\t");
 		std::visit(Util::Overloaded {
-			[&os](const Mod::Uppercase&) {
-				os << "Uppercase [ ]";
+			[this](const Mod::Uppercase&) {
+				put("Uppercase [ ]");
 			},
 		}, mod);
 	}
+}
+
+/* ~~ Print Sketch ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+std::ostream& operator<<(std::ostream& os, const Sketch& sketch) {
+	TextWriter {os}.write(sketch);
 	return os;
-}
\ No newline at end of file
+}
+
+std::ostream& operator<<(std::ostream& os, const Element& element) {
+	TextWriter {os}.write(element);
+	return os;
+}
+
+/* ~~ Print Atoms ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+std::ostream& operator<<(std::ostream& os, const StrokeAtoms& v) {
+	TextWriter {os}.write(v);
+	return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const FlatStrokeAtoms& v) {
+	TextWriter {os}.write(v);
+	return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const MarkerAtom& m) {
+	TextWriter {os}.write(m);
+	return os;
+}
+
+/* ~~ Print Modifiers ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+std::ostream& operator<<(std::ostream& os, const StrokeModifiers v) {
+	TextWriter {os}.write(v);
+	return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const MarkerModifiers v) {
+	TextWriter {os}.write(v);
+	return os;
+}
@@ -1,9 +1,13 @@
 #pragma once
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 #include <span>
+#include "persistent.hh"
 #include "util.hh"
 
 /* ~~ Atom Types ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -14,11 +18,13 @@ namespace Atom
 		struct Point {
 			int x, y;
 			Point(int x, int y);
+			bool operator==(const Point&) const = default;
 		};
 		std::vector<Point> points;
 
 		FlatStroke();
 		FlatStroke(std::vector<Point>);
+		bool operator==(const FlatStroke&) const = default;
 	};
 
 	struct Stroke {
@@ -38,10 +44,86 @@ namespace Atom
 	// struct Pattern { /* ... */ };
 	// struct Mask    { /* ... */ };
 	// struct Eraser  { Mask shape; };
-	struct Marker  { std::string text; };
+	struct Marker  {
+		std::string text;
+		bool operator==(const Marker&) const = default;
+	};
 }
 
-using StrokeAtoms     = std::vector<Atom::Stroke>;
+// Brush strokes stored column-wise: every point's x, y and pressure
+// in an array of their own, and each stroke a range of those. Points
+// are at most 3 base-36 digits per coordinate, (so 16 bits is plenty,
+// and anything past it is clamped), and pressure stays the 2 digit
+// number the file has, 0 to 1295.
+class StrokeAtoms {
+public:
+	static constexpr unsigned PressureMax = 36*36-1;
+
+	// One stroke's slice of the columns.
+	struct View {
+		unsigned diameter;
+		std::span<const int16_t> x, y;
+		std::span<const uint16_t> pressure;
+
+		auto size() const -> std::size_t;
+		auto operator[](std::size_t) const -> Atom::Stroke::Point;
+		explicit operator Atom::Stroke() const;
+	};
+
+	class Iterator {
+		const StrokeAtoms* atoms = nullptr;
+		std::size_t i = 0;
+	public:
+		using value_type = View;
+		using difference_type = std::ptrdiff_t;
+		Iterator() = default;
+		Iterator(const StrokeAtoms*, std::size_t);
+		auto operator*() const -> View;
+		auto operator++() -> Iterator&;
+		auto operator++(int) -> Iterator;
+		bool operator==(const Iterator&) const = default;
+	};
+
+private:
+	struct Columns {
+		std::vector<int16_t> xs, ys;
+		std::vector<uint16_t> pressures;
+		std::vector<uint32_t> offsets {0}; // Stroke i is [offsets[i], offsets[i+1]).
+		std::vector<uint16_t> diameters;
+	};
+	// Copies share columns, which only ever get appended to, so each
+	// copy just remembers how many strokes of them are its own. (One
+	// that's behind the columns' end copies them before pushing.)
+	std::shared_ptr<Columns> columns;
+	std::size_t strokes = 0;
+
+public:
+	StrokeAtoms();
+	StrokeAtoms(const std::vector<Atom::Stroke>&);
+
+	void push_back(const Atom::Stroke&);
+	void reserve(std::size_t strokes);
+	// Same strokes, point for point, (and quick for copies sharing columns).
+	bool operator==(const StrokeAtoms&) const;
+	// Whether other is these strokes with more pushed on, in the same
+	// columns, (so it's quick, but a copy that had to copy its columns
+	// won't count).
+	bool prefixOf(const StrokeAtoms& other) const;
+	auto size() const -> std::size_t;
+	bool empty() const;
+	auto operator[](std::size_t) const -> View;
+	auto begin() const -> Iterator;
+	auto end() const -> Iterator;
+
+	// Inclusive box of all the points, (lo > hi when there are none).
+	// A straight pass down each column, with no strokes in the way.
+	auto bounds() const
+	-> std::pair<Atom::FlatStroke::Point, Atom::FlatStroke::Point>;
+};
+
+// (Pencil and Data strokes stay a vector of FlatStrokes, the same type
+// flattening gives and the renderer takes, so they're handed over as
+// they are instead of converted every render.)
 using FlatStrokeAtoms = std::vector<Atom::FlatStroke>;
 using MarkerAtom      = Atom::Marker;
 
@@ -61,7 +143,14 @@ namespace Mod
 		Affine(double);
 		Affine(std::array<double,9>);
 		auto operator*(Affine) const -> Affine;
+		bool operator==(const Affine&) const = default;
 		Call_t<Atom::Stroke> operator();
+		// Truncates to integers, same as the stroke version.
+		auto operator()(Atom::FlatStroke::Point) const
+		-> Atom::FlatStroke::Point;
+		// Inclusive box holding the transformed points of the given one.
+		auto operator()(std::pair<Atom::FlatStroke::Point, Atom::FlatStroke::Point>) const
+		-> std::pair<Atom::FlatStroke::Point, Atom::FlatStroke::Point>;
 	};
 
 	class Array {
@@ -69,7 +158,10 @@ namespace Mod
 		std::size_t N;
 		Affine transformation;
 		Array(std::size_t n, Affine tf);
+		bool operator==(const Array&) const = default;
 		Call_t<Atom::Stroke> operator();
+		// Every power of the transformation, from 0 to N-1.
+		auto powers() const -> std::vector<Affine>;
 	};
 
 	using Of_Stroke = std::variant<Affine, Array>;
@@ -79,6 +171,7 @@ namespace Mod
 	class Uppercase {
 	public:
 		Uppercase();
+		bool operator==(const Uppercase&) const = default;
 		Call_t<Atom::Marker> operator();
 	};
 
@@ -91,7 +184,10 @@ using MarkerModifiers = std::vector<Mod::Of_Marker>;
 /* ~~ Elements Type ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 template <typename A, typename M>
-struct Element_Base { A atoms; M modifiers; };
+struct Element_Base {
+	A atoms; M modifiers;
+	bool operator==(const Element_Base&) const = default;
+};
 struct Brush  : Element_Base <StrokeAtoms    , StrokeModifiers> {};
 struct Pencil : Element_Base <FlatStrokeAtoms, StrokeModifiers> {};
 struct Data   : Element_Base <FlatStrokeAtoms, StrokeModifiers> {};
@@ -114,6 +210,38 @@ using Element = std::variant<
 
 /* ~~ Main Sketch Types ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+// Strokes of one element, plus the copies its modifiers make of them,
+// without writing those copies out. Each stage holds the matrices a
+// modifier can apply, (just the one for Affine, N of them for Array),
+// and each instance picks one matrix per stage, applied in order.
+// Nested Arrays multiply the instance count, but only add up stages.
+class FlatInstances {
+public:
+	using Point = Atom::FlatStroke::Point;
+	using Stage = std::vector<Mod::Affine>;
+
+	FlatStrokeAtoms strokes;
+	std::vector<Stage> stages;
+
+private:
+	// Inclusive bounding boxes, (lo > hi when there are no points).
+	std::pair<Point,Point> baseBounds, allBounds;
+
+public:
+	FlatInstances();
+	FlatInstances(FlatStrokeAtoms, std::vector<Stage> = {});
+
+	auto size() const -> std::size_t;
+	auto apply(std::size_t instance, Point) const -> Point;
+	auto bounds(std::size_t instance) const -> std::pair<Point,Point>;
+	auto bounds() const -> std::pair<Point,Point>;
+	// Every instance's strokes, in the order applying
+	// the modifiers one after another would give.
+	auto materialize() const -> FlatStrokeAtoms;
+};
+
+using SharedInstances = std::shared_ptr<const FlatInstances>;
+
 struct FlatSketch {
 	std::vector<Atom::FlatStroke> strokes;
 
@@ -121,17 +249,152 @@ struct FlatSketch {
 	FlatSketch(std::vector<Atom::FlatStroke>);
 };
 
+// Hash of everything an element holds, (atoms and modifiers),
+// so equal elements hash equal whichever Sketch they live in.
+auto contentHash(const Element&) -> uint64_t;
+
+// Flattened strokes of each element seen. Elements are found by their
+// storage, (which copies of a sketch share), so one seen before costs
+// a lookup. New ones get their contentHash taken once, and reuse the
+// strokes of an element seen before if it's equal. Entries not used by
+// the last MaxAge renders are dropped.
+//
+// Brushes, (unless their modifiers make copies), are flattened Run
+// strokes at a time, so a Brush that's the one drawn in the same place
+// last render with strokes added on only flattens the new strokes.
+class FlattenCache {
+public:
+	// Hits and misses count pieces, (elements, or runs of a Brush),
+	// and strokes counts the strokes flattened for the misses.
+	struct Stats { std::size_t hits=0, misses=0, entries=0, strokes=0; };
+	using ElementPtr = std::shared_ptr<const Element>;
+	static constexpr std::size_t MaxAge = 64;
+	static constexpr std::size_t Run = 64;
+
+private:
+	struct Entry {
+		// Held on to, so its address can't be reused, and it can't be
+		// edited in place (see PersistentVector::editBack).
+		ElementPtr element;
+		uint64_t hash;
+		std::vector<SharedInstances> pieces;
+		bool runs; // (Whether pieces are a Brush's runs.)
+		std::size_t lastUsed;
+	};
+	std::unordered_map<const Element*, Entry> entries;
+	std::unordered_map<uint64_t, const Element*> byContent;
+	// Elements in the order they were asked for, this render and last.
+	std::vector<ElementPtr> current, previous;
+	std::size_t generation = 0;
+	Stats counters {};
+
+	auto grown(const Element&) const -> const Entry*;
+
+public:
+	// Elements are asked for in the order they're drawn, and the
+	// pieces stay valid until the render ends.
+	auto get(ElementPtr) -> std::span<const SharedInstances>;
+	void sweep(); // Ends a render.
+	auto stats() const -> Stats;
+	void resetStats();
+};
+
+// Takes a sketch's strokes a point at a time, straight from its
+// elements through their modifiers, with no copies made in between.
+class StrokeVisitor {
+public:
+	using Point = Atom::FlatStroke::Point;
+	virtual ~StrokeVisitor() = default;
+
+	// Asked before each instance of an element, with its inclusive
+	// bounds. Returning false skips all its strokes.
+	virtual bool wants(Point lo, Point hi) { return true; }
+	virtual void beginStroke() = 0;
+	virtual void point(Point) = 0;
+};
+
+// Sketch::visit, for just the one element.
+void visitElement(const Element&, StrokeVisitor&);
+// Inclusive box of an element's own points, before any modifiers,
+// (lo > hi when there are none, like for Markers).
+auto strokeBounds(const Element&)
+-> std::pair<StrokeVisitor::Point, StrokeVisitor::Point>;
+// Whether any instance of a box under these modifiers is wanted,
+// (asking the visitor once per instance, as visiting would).
+bool wantsAny(
+	StrokeVisitor&,
+	std::pair<StrokeVisitor::Point, StrokeVisitor::Point> box,
+	const StrokeModifiers&
+);
+
 struct Sketch {
-	std::vector<Element> elements;
+	// Copies of a sketch share all their elements, (see History).
+	PersistentVector<Element> elements;
+	// Whatever the sketch was parsed from in place, (a MappedFile),
+	// kept alive for as long as any copy of the sketch is.
+	std::shared_ptr<const void> source {};
 
 	Sketch();
 	Sketch(std::vector<Element>);
 	Sketch(const FlatSketch&);
 	auto render() const -> FlatSketch;
+	// Same as render(), but only flattens elements the cache
+	// hasn't seen yet.
+	auto render(FlattenCache&) const -> FlatSketch;
+	// One entry per element, (or per Run strokes of a Brush), without
+	// copying out the instances.
+	auto renderInstances(FlattenCache&) const
+	-> std::vector<SharedInstances>;
+	// Streams the same strokes render() returns, in the same order.
+	void visit(StrokeVisitor&) const;
 };
 
 /* ~~ Print Functions ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+// Writes sketch text into one contiguous buffer, digits and all, with
+// no strings made along the way. Either appends to a string the caller
+// owns, (keeping its capacity from one use to the next), or goes out
+// to a stream a chunk at a time. The operator<<s below all go through
+// one, so it's the same bytes either way.
+class TextWriter {
+	std::string chunk {};
+	std::string& buffer;
+	std::ostream* sink = nullptr;
+
+	// Room for n more chars to be written straight into, then
+	// given back to commit() with where writing stopped.
+	auto reserve(std::size_t n) -> char*;
+	void commit(char* end);
+	void put(std::string_view);
+	void put(double);
+	void put(std::size_t);
+	void flushIfFull();
+
+public:
+	static constexpr std::size_t ChunkSize = 1 << 16;
+
+	TextWriter(std::string& output);
+	TextWriter(std::ostream& output);
+	TextWriter(const TextWriter&) = delete;
+	~TextWriter();
+	void flush(); // (Only does anything for a stream.)
+
+	void write(const Sketch&);
+	void write(const Element&);
+	void write(const StrokeAtoms&);
+	void write(const FlatStrokeAtoms&);
+	void write(const MarkerAtom&);
+	void write(const StrokeModifiers&);
+	void write(const MarkerModifiers&);
+	// The ".sketch" format, (see RawFormat).
+	void writeRaw(const FlatSketch&);
+
+	// Pieces of the above, for writing out a sketch as it's read.
+	void write(std::string_view); // (As it is.)
+	void write(const Atom::FlatStroke&); // (One of FlatStrokeAtoms.)
+	void writeRaw(const Atom::FlatStroke&);
+};
+
 // Sketch
 std::ostream& operator<<(std::ostream& os, const Sketch&);
 std::ostream& operator<<(std::ostream& os, const Element&);
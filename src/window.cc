@@ -1,5 +1,6 @@
 #include "window.hh"
 #include <iostream>
+#include <vector>
 
 Window::Window(std::string_view title, unsigned W, unsigned H)
 : m_W{W}, m_H{H} {
@@ -18,8 +19,9 @@ Window::Window(std::string_view title, unsigned W, unsigned H)
 
 	// Convert void* array to a span<uint32>
 	// because type-less pointers are yucky.
+	// (pitch is in bytes, not pixels.)
 	uint32_t* start = (uint32_t*)sdlSurface->pixels;
-	std::size_t size = sdlSurface->h * sdlSurface->pitch;
+	std::size_t size = sdlSurface->h * sdlSurface->pitch / sizeof(uint32_t);
 	pixels = std::span {start, start+size};
 
 	format = sdlSurface->format;
@@ -45,3 +47,15 @@ void Window::setSize (Dimension d) {
 }
 
 void Window::updatePixels() { SDL_UpdateWindowSurface(sdlWindow); }
+
+
+void Window::updatePixels(std::span<const Rect> rects) {
+	std::vector<SDL_Rect> sdlRects {};
+	for (Rect r : rects) {
+		r = intersect(r, {0, 0, int(m_W), int(m_H)});
+		if (isEmpty(r)) continue;
+		sdlRects.push_back({r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0});
+	}
+	if (sdlRects.empty()) return;
+	SDL_UpdateWindowSurfaceRects(sdlWindow, sdlRects.data(), sdlRects.size());
+}
\ No newline at end of file
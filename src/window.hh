@@ -1,5 +1,6 @@
 #pragma once
 #include <SDL2/SDL.h>
+#include "graphics.hh"
 #include <string_view>
 #include <span>
 #include <cctype>
@@ -27,4 +28,5 @@ public:
 	// Setters
 	void setSize  (Dimension);
 	void updatePixels();
+	void updatePixels(std::span<const Rect>);
 };
\ No newline at end of file